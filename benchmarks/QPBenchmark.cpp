@@ -0,0 +1,250 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+// Solve-loop benchmarks: times problem(), the first solve and repeated
+// re-solves of slightly perturbed random QPs, and splits the re-solve time
+// between the wrapper and Gurobi itself.
+//
+// Usage: EigenGurobi_benchmarks [maxDenseVars] [maxSparseVars] [nrResolve]
+
+// includes
+// std
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Eigen
+#include <Eigen/Dense>
+
+// eigen-gurobi
+#include <Gurobi.h>
+
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Timings
+{
+	Timings():
+		problem(0.), first(0.), resolve(0.), gurobi(0.),
+		objective(0.), bounds(0.), constraints(0.), update(0.), optimize(0.), extraction(0.),
+		nrFailed(0)
+	{ }
+
+	void add(const Eigen::GurobiCommon::SolveStats& stats)
+	{
+		gurobi += 1e3*stats.runtime;
+		objective += 1e3*stats.objectiveTime;
+		bounds += 1e3*stats.boundsTime;
+		constraints += 1e3*stats.constraintsTime;
+		update += 1e3*stats.updateTime;
+		optimize += 1e3*stats.optimizeTime;
+		extraction += 1e3*stats.extractionTime;
+	}
+
+	void average(int n)
+	{
+		for(double* t : {&resolve, &gurobi, &objective, &bounds, &constraints, &update, &optimize, &extraction})
+		{
+			*t /= n;
+		}
+	}
+
+	double problem, first, resolve, gurobi;
+	double objective, bounds, constraints, update, optimize, extraction;
+	int nrFailed;
+};
+
+/// Random feasible QP: x0 is strictly inside the bounds and satisfies all the constraints.
+struct DenseQP
+{
+	DenseQP(int nrvar, std::mt19937& gen)
+	{
+		std::uniform_real_distribution<double> dist(-1., 1.);
+		auto rnd = [&](int r, int c) {
+			Eigen::MatrixXd M(r, c);
+			for(int i = 0; i < M.size(); ++i) M(i) = dist(gen);
+			return M;
+		};
+
+		nreq = nrvar/4;
+		nrineq = nrvar/2;
+		Eigen::MatrixXd M = rnd(nrvar, nrvar);
+		Q = M.transpose()*M + Eigen::MatrixXd::Identity(nrvar, nrvar);
+		C = rnd(nrvar, 1);
+		Eigen::VectorXd x0 = rnd(nrvar, 1);
+		Aeq = rnd(nreq, nrvar);
+		Beq = Aeq*x0;
+		Aineq = rnd(nrineq, nrvar);
+		Bineq = Aineq*x0 + Eigen::VectorXd::Ones(nrineq);
+		XL = Eigen::VectorXd::Constant(nrvar, -10.);
+		XU = Eigen::VectorXd::Constant(nrvar, 10.);
+	}
+
+	int nreq, nrineq;
+	Eigen::MatrixXd Q, Aeq, Aineq;
+	Eigen::VectorXd C, Beq, Bineq, XL, XU;
+};
+
+struct SparseQP
+{
+	SparseQP(int nrvar, std::mt19937& gen)
+	{
+		const int nnzPerRow = 5;
+		std::uniform_real_distribution<double> dist(-1., 1.);
+		std::uniform_int_distribution<int> col(0, nrvar - 1);
+		auto rnd = [&](int rows) {
+			std::vector<Eigen::Triplet<double>> triplets;
+			for(int i = 0; i < rows; ++i)
+				for(int k = 0; k < nnzPerRow; ++k)
+					triplets.emplace_back(i, col(gen), dist(gen));
+			Eigen::SparseMatrix<double> A(rows, nrvar);
+			A.setFromTriplets(triplets.begin(), triplets.end());
+			return A;
+		};
+
+		nreq = nrvar/4;
+		nrineq = nrvar/2;
+
+		// Diagonally dominant, hence positive definite, tridiagonal Hessian
+		std::vector<Eigen::Triplet<double>> qtriplets;
+		for(int i = 0; i < nrvar; ++i)
+		{
+			qtriplets.emplace_back(i, i, 3.);
+			if(i + 1 < nrvar)
+			{
+				qtriplets.emplace_back(i, i + 1, -1.);
+				qtriplets.emplace_back(i + 1, i, -1.);
+			}
+		}
+		Q.resize(nrvar, nrvar);
+		Q.setFromTriplets(qtriplets.begin(), qtriplets.end());
+
+		Eigen::VectorXd x0(nrvar), c(nrvar);
+		for(int i = 0; i < nrvar; ++i)
+		{
+			x0(i) = dist(gen);
+			c(i) = dist(gen);
+		}
+		C = c.sparseView();
+		Aeq = rnd(nreq);
+		Beq = (Aeq*x0).sparseView();
+		Aineq = rnd(nrineq);
+		Bineq = (Aineq*x0 + Eigen::VectorXd::Ones(nrineq)).sparseView();
+		XL = Eigen::VectorXd::Constant(nrvar, -10.);
+		XU = Eigen::VectorXd::Constant(nrvar, 10.);
+	}
+
+	int nreq, nrineq;
+	Eigen::SparseMatrix<double> Q, Aeq, Aineq;
+	Eigen::SparseVector<double> C, Beq, Bineq;
+	Eigen::VectorXd XL, XU;
+};
+
+/// Small perturbation of the linear objective, as in a receding-horizon loop.
+template<typename Vector>
+void perturb(Vector& C, std::mt19937& gen)
+{
+	std::uniform_real_distribution<double> dist(-1e-3, 1e-3);
+	for(int i = 0; i < C.size(); ++i)
+	{
+		C.coeffRef(i) += dist(gen);
+	}
+}
+
+template<typename QP, typename Solver>
+Timings run(const QP& qp0, int nrvar, int nrResolve, std::mt19937& gen)
+{
+	Timings t;
+	QP qp(qp0);
+
+	Clock::time_point start = Clock::now();
+	Solver solver;
+	solver.problem(nrvar, qp.nreq, qp.nrineq);
+	t.problem = elapsedMs(start);
+	solver.displayOutput(false);
+	solver.collectStats(true);
+
+	start = Clock::now();
+	t.nrFailed += !solver.solve(qp.Q, qp.C, qp.Aeq, qp.Beq, qp.Aineq, qp.Bineq, qp.XL, qp.XU);
+	t.first = elapsedMs(start);
+
+	for(int i = 0; i < nrResolve; ++i)
+	{
+		perturb(qp.C, gen);
+		start = Clock::now();
+		t.nrFailed += !solver.solve(qp.Q, qp.C, qp.Aeq, qp.Beq, qp.Aineq, qp.Bineq, qp.XL, qp.XU);
+		t.resolve += elapsedMs(start);
+		t.add(solver.stats());
+	}
+
+	if(nrResolve > 0)
+	{
+		t.average(nrResolve);
+	}
+	return t;
+}
+
+void report(const char* name, int nrvar, int nreq, int nrineq, const Timings& t)
+{
+	std::printf("%-7s %8d %8d %8d %10.3f %10.3f %10.3f %10.3f %10.3f"
+		" %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %7d\n",
+		name, nrvar, nreq, nrineq, t.problem, t.first, t.resolve, t.gurobi,
+		t.resolve - t.gurobi, t.objective, t.bounds, t.constraints, t.update,
+		t.optimize, t.extraction, t.nrFailed);
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+	const int maxDense = argc > 1 ? std::atoi(argv[1]) : 1000;
+	const int maxSparse = argc > 2 ? std::atoi(argv[2]) : 100000;
+	const int nrResolve = argc > 3 ? std::atoi(argv[3]) : 20;
+
+	std::mt19937 gen(42);
+
+	std::printf("All times in ms; the columns after first are averages over %d re-solves\n", nrResolve);
+	std::printf("%-7s %8s %8s %8s %10s %10s %10s %10s %10s"
+		" %10s %10s %10s %10s %10s %10s %7s\n",
+		"solver", "nrvar", "nreq", "nrineq", "problem", "first", "re-solve", "gurobi", "wrapper",
+		"objective", "bounds", "constr", "update", "optimize", "extract", "failed");
+
+	for(int nrvar = 10; nrvar <= maxDense; nrvar *= 10)
+	{
+		DenseQP qp(nrvar, gen);
+		Timings t = run<DenseQP, Eigen::GurobiDense>(qp, nrvar, nrResolve, gen);
+		report("dense", nrvar, qp.nreq, qp.nrineq, t);
+	}
+
+	for(int nrvar = 10; nrvar <= maxSparse; nrvar *= 10)
+	{
+		SparseQP qp(nrvar, gen);
+		Timings t = run<SparseQP, Eigen::GurobiSparse>(qp, nrvar, nrResolve, gen);
+		report("sparse", nrvar, qp.nreq, qp.nrineq, t);
+	}
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+// Replays a solve log written by GurobiRecorder and times each solve, split
+// between the wrapper and Gurobi itself. The recorded parameters can be
+// replaced by one of the SolverParameters presets.
+//
+// Usage: EigenGurobi_replay log [recorded|realTime|offline] [nrPasses]
+
+// includes
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// eigen-gurobi
+#include <Gurobi.h>
+#include <GurobiRecorder.h>
+
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+template<typename Solver>
+bool replaySolve(const Eigen::GurobiReplay& replay, Solver& qp,
+	const Eigen::GurobiCommon::SolverParameters* preset, double& ms, double& gurobiMs)
+{
+	replay.setup(qp, preset == nullptr);
+	if (preset != nullptr)
+	{
+		qp.parameters(*preset);
+	}
+
+	Clock::time_point start = Clock::now();
+	bool success = replay.solve(qp);
+	ms = elapsedMs(start);
+	gurobiMs = 1e3*qp.stats().runtime;
+	return success;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "Usage: %s log [recorded|realTime|offline] [nrPasses]\n", argv[0]);
+		return 1;
+	}
+	const char* params = argc > 2 ? argv[2] : "recorded";
+	const int nrPasses = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 1;
+
+	Eigen::GurobiCommon::SolverParameters preset;
+	const Eigen::GurobiCommon::SolverParameters* presetPtr = &preset;
+	if (std::strcmp(params, "realTime") == 0)
+	{
+		preset = Eigen::GurobiCommon::SolverParameters::realTime();
+	}
+	else if (std::strcmp(params, "offline") == 0)
+	{
+		preset = Eigen::GurobiCommon::SolverParameters::offline();
+	}
+	else if (std::strcmp(params, "recorded") == 0)
+	{
+		presetPtr = nullptr;
+	}
+	else
+	{
+		std::fprintf(stderr, "Unknown parameters %s\n", params);
+		return 1;
+	}
+
+	try
+	{
+		Eigen::GurobiReplay replay(argv[1]);
+		Eigen::GurobiDense dense;
+		dense.displayOutput(false);
+		dense.collectStats(true);
+		Eigen::GurobiSparse sparse;
+		sparse.displayOutput(false);
+		sparse.collectStats(true);
+
+		std::printf("All times in ms\n");
+		std::printf("%5s %6s %-7s %8s %8s %8s %10s %10s %10s %7s\n",
+			"pass", "record", "solver", "nrvar", "nreq", "nrineq", "solve", "gurobi", "wrapper", "status");
+
+		double total = 0., maxMs = 0.;
+		int nrSolves = 0, nrFailed = 0;
+		for(int pass = 0; pass < nrPasses; ++pass)
+		{
+			replay.rewind();
+			for(int record = 0; replay.next(); ++record)
+			{
+				double ms = 0., gurobiMs = 0.;
+				bool success;
+				int status;
+				if (replay.kind() == Eigen::GurobiRecorder::DENSE)
+				{
+					success = replaySolve(replay, dense, presetPtr, ms, gurobiMs);
+					status = dense.status();
+				}
+				else
+				{
+					success = replaySolve(replay, sparse, presetPtr, ms, gurobiMs);
+					status = sparse.status();
+				}
+
+				std::printf("%5d %6d %-7s %8d %8d %8d %10.3f %10.3f %10.3f %7d\n",
+					pass, record, replay.kind() == Eigen::GurobiRecorder::DENSE ? "dense" : "sparse",
+					replay.nrvar(), replay.nreq(), replay.nrineq(), ms, gurobiMs, ms - gurobiMs, status);
+				total += ms;
+				maxMs = std::max(maxMs, ms);
+				++nrSolves;
+				nrFailed += !success;
+			}
+		}
+
+		std::printf("%d solves, %d failed: total %.3f ms, mean %.3f ms, max %.3f ms\n",
+			nrSolves, nrFailed, total, nrSolves > 0 ? total/nrSolves : 0., maxMs);
+	}
+	catch(const char* error)
+	{
+		std::fprintf(stderr, "%s\n", error);
+		return 1;
+	}
+	catch(const GRBException& e)
+	{
+		std::fprintf(stderr, "Gurobi error %d: %s\n", e.getErrorCode(), e.getMessage().c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -16,7 +16,272 @@
 // associated header
 #include "Gurobi.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <thread>
 #include <type_traits>
+#include <utility>
+
+// eigen-gurobi
+#include "GurobiRecorder.h"
+
+namespace
+{
+
+/// Adds the wall time spent in its scope to a counter, when enabled.
+class ScopedTimer
+{
+public:
+	ScopedTimer(bool enabled, double& total):
+		enabled_(enabled),
+		total_(total),
+		start_(enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+	{ }
+
+	~ScopedTimer()
+	{
+		if (enabled_)
+		{
+			total_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+		}
+	}
+
+private:
+	bool enabled_;
+	double& total_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+/// True for the statuses of an optimization stopped by a limit, after
+/// which Gurobi may have found a solution.
+bool isLimitStatus(int status)
+{
+	switch(status)
+	{
+		case GRB_ITERATION_LIMIT:
+		case GRB_NODE_LIMIT:
+		case GRB_TIME_LIMIT:
+		case GRB_SOLUTION_LIMIT:
+		case GRB_INTERRUPTED:
+		case GRB_USER_OBJ_LIMIT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ Computes the new index of each of len elements once the elements at the
+ given indices are erased.
+ @param map Receives the new index of each element, -1 for the erased ones.
+ @return The number of elements left.
+ */
+int indexMap(int len, const std::vector<int>& removed, std::vector<int>& map)
+{
+	map.assign(static_cast<size_t>(len), 0);
+	for(int i: removed)
+	{
+		assert(0 <= i && i < len);
+		map[static_cast<size_t>(i)] = -1;
+	}
+
+	int next = 0;
+	for(int& m: map)
+	{
+		if(m == 0)
+		{
+			m = next++;
+		}
+	}
+	return next;
+}
+
+/// Erases the rows of M mapped to -1 by indexMap, if M has one row per
+/// element. The caches that are not allocated yet are left as is.
+template<typename Mat>
+void eraseRows(Mat& M, const std::vector<int>& map, int newLen)
+{
+	if(M.rows() != static_cast<Eigen::Index>(map.size()))
+	{
+		return;
+	}
+	for(Eigen::Index i = 0; i < M.rows(); ++i)
+	{
+		const int j = map[static_cast<size_t>(i)];
+		if(j >= 0 && j != i)
+		{
+			M.row(j) = M.row(i);
+		}
+	}
+	M.conservativeResize(newLen, M.cols());
+}
+
+template<typename T>
+void eraseRows(std::vector<T>& v, const std::vector<int>& map, int newLen)
+{
+	for(size_t i = 0; i < v.size(); ++i)
+	{
+		const int j = map[i];
+		if(j >= 0)
+		{
+			v[static_cast<size_t>(j)] = v[i];
+		}
+	}
+	v.erase(v.begin()+newLen, v.end());
+}
+
+/// Same as eraseRows for the columns of M.
+template<typename Mat>
+void eraseCols(Mat& M, const std::vector<int>& map, int newLen)
+{
+	if(M.cols() != static_cast<Eigen::Index>(map.size()))
+	{
+		return;
+	}
+	for(Eigen::Index i = 0; i < M.cols(); ++i)
+	{
+		const int j = map[static_cast<size_t>(i)];
+		if(j >= 0 && j != i)
+		{
+			M.col(j) = M.col(i);
+		}
+	}
+	M.conservativeResize(M.rows(), newLen);
+}
+
+/// Appends rows filled with value to M, if M has oldLen rows.
+template<typename Mat>
+void growRows(Mat& M, int oldLen, int newLen, typename Mat::Scalar value)
+{
+	if(M.rows() == oldLen)
+	{
+		M.conservativeResize(newLen, M.cols());
+		M.bottomRows(newLen - oldLen).setConstant(value);
+	}
+}
+
+/// Same as growRows for the columns of M.
+template<typename Mat>
+void growCols(Mat& M, int oldLen, int newLen, typename Mat::Scalar value)
+{
+	if(M.cols() == oldLen)
+	{
+		M.conservativeResize(M.rows(), newLen);
+		M.rightCols(newLen - oldLen).setConstant(value);
+	}
+}
+
+/// Index of a variable or constraint from the name given by saveModel(),
+/// -1 if the name does not start with the prefix.
+int indexFromName(const std::string& name, char prefix)
+{
+	if (name.size() < 2 || name[0] != prefix)
+	{
+		return -1;
+	}
+	char* end = nullptr;
+	long index = std::strtol(name.c_str() + 1, &end, 10);
+	return *end == '\0' ? static_cast<int>(index) : -1;
+}
+
+template<typename Vec>
+void writeVector(std::ostream& out, const Vec& v)
+{
+	for(Eigen::Index i = 0; i < v.rows(); ++i)
+	{
+		out << v(i) << ' ';
+	}
+	out << '\n';
+}
+
+template<typename Vec>
+void readVector(std::istream& in, Vec& v, int len)
+{
+	v.resize(len);
+	for(int i = 0; i < len; ++i)
+	{
+		in >> v(i);
+	}
+}
+
+/// Number of instances of a parametric solve: the data have one column per
+/// instance, or a single column shared by all the instances.
+Eigen::Index parametricSize(const Eigen::Ref<const Eigen::MatrixXd>& Cs,
+	const Eigen::Ref<const Eigen::MatrixXd>& Beqs, const Eigen::Ref<const Eigen::MatrixXd>& Bineqs)
+{
+	const Eigen::Index nrInst = std::max(Cs.cols(), std::max(Beqs.cols(), Bineqs.cols()));
+	assert(Cs.cols() == 1 || Cs.cols() == nrInst);
+	assert(Beqs.cols() == 1 || Beqs.cols() == nrInst);
+	assert(Bineqs.cols() == 1 || Bineqs.cols() == nrInst);
+	return nrInst;
+}
+
+/// Column of M holding the data of instance k of a parametric solve.
+Eigen::Index instanceCol(const Eigen::Ref<const Eigen::MatrixXd>& M, Eigen::Index k)
+{
+	return M.cols() == 1 ? 0 : k;
+}
+
+/// True if A and B have the same size, sparsity pattern and values, whether
+/// they are compressed or not.
+bool sameSparse(const Eigen::SparseMatrix<double>& A, const Eigen::SparseMatrix<double>& B)
+{
+	if(A.rows() != B.rows() || A.cols() != B.cols() || A.nonZeros() != B.nonZeros())
+	{
+		return false;
+	}
+	for(Eigen::Index k = 0; k < A.outerSize(); ++k)
+	{
+		Eigen::SparseMatrix<double>::InnerIterator b(B, k);
+		for(Eigen::SparseMatrix<double>::InnerIterator a(A, k); a; ++a, ++b)
+		{
+			if(!b || a.index() != b.index() || a.value() != b.value())
+			{
+				return false;
+			}
+		}
+		if(b)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Bytes allocated by a dense matrix or vector.
+template<typename Derived>
+std::size_t bytes(const Eigen::PlainObjectBase<Derived>& M)
+{
+	return static_cast<std::size_t>(M.size())*sizeof(typename Derived::Scalar);
+}
+
+/// Bytes allocated by a vector.
+template<typename T>
+std::size_t bytes(const std::vector<T>& v)
+{
+	return v.capacity()*sizeof(T);
+}
+
+/// Bytes allocated by a compressed sparse matrix.
+std::size_t bytes(const Eigen::SparseMatrix<double>& M)
+{
+	return static_cast<std::size_t>(M.data().allocatedSize())*(sizeof(double) + sizeof(int))
+		+ static_cast<std::size_t>(M.outerSize() + 1)*sizeof(int);
+}
+
+/// Releases the memory of a vector.
+template<typename T>
+void release(std::vector<T>& v)
+{
+	std::vector<T>().swap(v);
+}
+
+} // namespace
 
 namespace Eigen
 {
@@ -27,7 +292,118 @@ namespace Eigen
  */
 
 
+GurobiCommon::SolveStats::SolveStats()
+{
+	reset();
+}
+
+
+void GurobiCommon::SolveStats::reset()
+{
+	objectiveTime = 0.;
+	boundsTime = 0.;
+	constraintsTime = 0.;
+	updateTime = 0.;
+	optimizeTime = 0.;
+	extractionTime = 0.;
+	apiCalls = 0;
+	coeffsChanged = 0;
+	runtime = 0.;
+	simplexIterations = 0.;
+	barrierIterations = 0;
+	nodeCount = 0.;
+}
+
+
+GurobiCommon::SolveResult::SolveResult() noexcept:
+	status(0),
+	error(0),
+	quality(SolutionQuality::NONE),
+	hasDual(false),
+	x_(nullptr),
+	yeq_(nullptr),
+	yineq_(nullptr),
+	nrvar_(0),
+	nreq_(0),
+	nrineq_(0)
+{ }
+
+
+GurobiCommon::SolverParameters::SolverParameters():
+	method(Method::AUTOMATIC),
+	threads(0),
+	presolve(Presolve::AUTOMATIC),
+	crossover(-1),
+	barrierConvergenceTolerance(1e-8),
+	scaleFlag(-1),
+	numericFocus(0),
+	feasibilityTolerance(1e-6),
+	optimalityTolerance(1e-6)
+{
+}
+
+GurobiCommon::SolverParameters GurobiCommon::SolverParameters::realTime()
+{
+	SolverParameters params;
+	params.method = Method::DUAL_SIMPLEX;
+	params.threads = 1;
+	params.presolve = Presolve::OFF;
+	return params;
+}
+
+GurobiCommon::SolverParameters GurobiCommon::SolverParameters::offline()
+{
+	SolverParameters params;
+	params.method = Method::BARRIER;
+	params.threads = 0;
+	return params;
+}
+
 GurobiCommon::GurobiCommon():
+	GurobiCommon(std::make_shared<GRBEnv>())
+{
+}
+
+
+GurobiCommon::GurobiCommon(std::shared_ptr<GRBEnv> env):
+	Q_(),
+	C_(),
+	Beq_(),
+	Bineq_(),
+	X_(),
+	Yeq_(),
+	Yineq_(),
+	status_(0),
+	nrvar_(0),
+	nreq_(0),
+	nrineq_(0),
+	iter_(0),
+	error_(0),
+	quality_(SolutionQuality::NONE),
+	resultPolicy_(ResultPolicy::OPTIMAL),
+	warmStatus_(WarmStatus::DEFAULT),
+	hasSolution_(false),
+	hasDual_(false),
+	hasBasis_(false),
+	userStart_(0),
+	extraction_(OUTPUT_PRIMAL | OUTPUT_DUAL),
+	extracted_(0),
+	collectStats_(false),
+	elementwiseAttr_(false),
+	stats_(),
+	lastStats_(),
+	env_(std::move(env)),
+	model_(*env_),
+	vars_(),
+	eqconstr_(),
+	ineqconstr_(),
+	ranged_(false),
+	rangeCached_(false)
+{
+}
+
+
+GurobiCommon::GurobiCommon(std::shared_ptr<GRBEnv> env, const std::string& path):
 	Q_(),
 	C_(),
 	Beq_(),
@@ -40,33 +416,250 @@ GurobiCommon::GurobiCommon():
 	nreq_(0),
 	nrineq_(0),
 	iter_(0),
-	env_(),
-	model_(env_)
+	error_(0),
+	quality_(SolutionQuality::NONE),
+	resultPolicy_(ResultPolicy::OPTIMAL),
+	warmStatus_(WarmStatus::DEFAULT),
+	hasSolution_(false),
+	hasDual_(false),
+	hasBasis_(false),
+	userStart_(0),
+	extraction_(OUTPUT_PRIMAL | OUTPUT_DUAL),
+	extracted_(0),
+	collectStats_(false),
+	elementwiseAttr_(false),
+	stats_(),
+	lastStats_(),
+	env_(std::move(env)),
+	model_(*env_, path),
+	vars_(),
+	eqconstr_(),
+	ineqconstr_(),
+	ranged_(false),
+	rangeCached_(false)
+{
+	model_.read(path + ".prm");
+
+	std::ifstream index(path + ".idx");
+	std::string header;
+	int version = 0;
+	index >> header >> version >> nrvar_ >> nreq_ >> nrineq_;
+	if (!index || header != "EigenGurobi" || version != 1)
+	{
+		throw "unable to read the index file of the model";
+	}
+
+	// Restore the order of the variables and constraints from their names
+	if (model_.get(GRB_IntAttr_NumVars) != nrvar_
+		|| model_.get(GRB_IntAttr_NumConstrs) != nreq_ + nrineq_)
+	{
+		throw "the model does not match its index file";
+	}
+	vars_.resize(static_cast<size_t>(nrvar_));
+	eqconstr_.resize(static_cast<size_t>(nreq_));
+	ineqconstr_.resize(static_cast<size_t>(nrineq_));
+
+	GRBVar* vars = model_.getVars();
+	for(int i = 0; i < nrvar_; ++i)
+	{
+		int k = indexFromName(vars[i].get(GRB_StringAttr_VarName), 'x');
+		if (k < 0 || k >= nrvar_)
+		{
+			delete[] vars;
+			throw "unknown variable in the model";
+		}
+		vars_[static_cast<size_t>(k)] = vars[i];
+	}
+	delete[] vars;
+
+	GRBConstr* constrs = model_.getConstrs();
+	for(int i = 0; i < nreq_ + nrineq_; ++i)
+	{
+		const std::string name = constrs[i].get(GRB_StringAttr_ConstrName);
+		int k = indexFromName(name, 'e');
+		if (0 <= k && k < nreq_)
+		{
+			eqconstr_[static_cast<size_t>(k)] = constrs[i];
+			continue;
+		}
+		k = indexFromName(name, 'i');
+		if (0 <= k && k < nrineq_)
+		{
+			ineqconstr_[static_cast<size_t>(k)] = constrs[i];
+			continue;
+		}
+		delete[] constrs;
+		throw "unknown constraint in the model";
+	}
+	delete[] constrs;
+
+	C_.resize(nrvar_);
+	Beq_.resize(nreq_);
+	Bineq_.resize(nrineq_);
+	X_.resize(nrvar_);
+	Yeq_.resize(nreq_);
+	Yineq_.resize(nrineq_);
+	colvars_.resize(static_cast<size_t>(std::max(nreq_, nrineq_)));
+
+	// Warm start information
+	int hasSolution = 0;
+	index >> hasSolution;
+	if (hasSolution)
+	{
+		readVector(index, X_, nrvar_);
+		readVector(index, Yeq_, nreq_);
+		readVector(index, Yineq_, nrineq_);
+	}
+	int hasBasis = 0;
+	index >> hasBasis;
+	if (hasBasis)
+	{
+		readVector(index, vbasis_, nrvar_);
+		readVector(index, eqbasis_, nreq_);
+		readVector(index, ineqbasis_, nrineq_);
+	}
+	if (!index)
+	{
+		throw "unable to read the index file of the model";
+	}
+	hasSolution_ = hasSolution != 0;
+	hasBasis_ = hasBasis != 0;
+}
+
+
+void GurobiCommon::saveModel(const std::string& path)
 {
+	if (ranged_)
+	{
+		throw "models with range inequalities cannot be saved";
+	}
+	// The index file only covers the variables and constraints of the
+	// problem, not those added by a solve form such as the least squares
+	// residuals
+	model_.update();
+	if (model_.get(GRB_IntAttr_NumVars) != nrvar_
+		|| model_.get(GRB_IntAttr_NumConstrs) != nreq_ + nrineq_)
+	{
+		throw "models with variables or constraints outside the problem cannot be saved";
+	}
+
+	// The duals of the warm start, while the model still has them
+	try
+	{
+		extract(OUTPUT_DUAL);
+	}
+	catch(const char*)
+	{
+	}
+
+	// Name the variables and constraints after their index in the wrapper,
+	// since the file formats do not keep an order
+	for(int i = 0; i < nrvar_; ++i)
+	{
+		vars_[i].set(GRB_StringAttr_VarName, "x" + std::to_string(i));
+	}
+	for(int i = 0; i < nreq_; ++i)
+	{
+		eqconstr_[static_cast<size_t>(i)].set(GRB_StringAttr_ConstrName, "e" + std::to_string(i));
+	}
+	for(int i = 0; i < nrineq_; ++i)
+	{
+		ineqconstr_[static_cast<size_t>(i)].set(GRB_StringAttr_ConstrName, "i" + std::to_string(i));
+	}
+	model_.update();
+	model_.write(path);
+	model_.write(path + ".prm");
+
+	std::ofstream index(path + ".idx");
+	index.precision(17);
+	index << "EigenGurobi 1\n" << nrvar_ << ' ' << nreq_ << ' ' << nrineq_ << '\n';
+	index << (hasSolution_ ? 1 : 0) << '\n';
+	if (hasSolution_)
+	{
+		writeVector(index, X_);
+		writeVector(index, Yeq_);
+		writeVector(index, Yineq_);
+	}
+	index << (hasBasis_ ? 1 : 0) << '\n';
+	if (hasBasis_)
+	{
+		writeVector(index, vbasis_);
+		writeVector(index, eqbasis_);
+		writeVector(index, ineqbasis_);
+	}
+	if (!index)
+	{
+		throw "unable to write the index file of the model";
+	}
 }
 
 
-int GurobiCommon::iter() const
+int GurobiCommon::iter() const noexcept
 {
 	return iter_;
 }
 
+int GurobiCommon::nrvar() const noexcept
+{
+	return nrvar_;
+}
+
+int GurobiCommon::nreq() const noexcept
+{
+	return nreq_;
+}
+
+int GurobiCommon::nrineq() const noexcept
+{
+	return nrineq_;
+}
+
 
-int GurobiCommon::status() const
+int GurobiCommon::status() const noexcept
 {
 	return status_;
 }
 
 
-bool GurobiCommon::success() const
+bool GurobiCommon::success() const noexcept
 {
 	return status_ == GRB_OPTIMAL || status_ == GRB_SUBOPTIMAL;
 }
 
 
+GurobiCommon::SolveResult GurobiCommon::solveResult() const noexcept
+{
+	SolveResult res;
+	res.status = status_;
+	res.error = error_;
+	res.quality = quality_;
+	if (quality_ != SolutionQuality::NONE)
+	{
+		res.x_ = X_.data();
+		res.nrvar_ = nrvar_;
+	}
+	if (hasDual_)
+	{
+		try
+		{
+			extract(OUTPUT_DUAL);
+			res.hasDual = true;
+			res.yeq_ = Yeq_.data();
+			res.yineq_ = Yineq_.data();
+			res.nreq_ = nreq_;
+			res.nrineq_ = nrineq_;
+		}
+		catch(...)
+		{
+		}
+	}
+	return res;
+}
+
+
 const VectorXd& GurobiCommon::result() const
 {
-	if (success()) {
+	if (quality_ != SolutionQuality::NONE) {
 		return X_;
 	}
 	throw "solve unsuccessful; unable to retrieve result";
@@ -74,7 +667,8 @@ const VectorXd& GurobiCommon::result() const
 
 const VectorXd& GurobiCommon::dual_eq() const
 {
-	if (success()) {
+	if (hasDual_) {
+		extract(OUTPUT_DUAL);
 		return Yeq_;
 	}
 	throw "solve unsuccessful; unable to retrieve dual_eq";
@@ -82,44 +676,144 @@ const VectorXd& GurobiCommon::dual_eq() const
 
 const VectorXd& GurobiCommon::dual_ineq() const
 {
-	if (success()) {
+	if (hasDual_) {
+		extract(OUTPUT_DUAL);
 		return Yineq_;
 	}
 	throw "solve unsuccessful; unable to retrieve dual_ineq";
 }
 
-GurobiCommon::WarmStatus GurobiCommon::warmStart() const
+const VectorXd& GurobiCommon::reduced_costs() const
 {
-	int ws = model_.get(GRB_IntParam_MultiObjMethod);
-	return static_cast<WarmStatus>(ws);
+	if (hasDual_) {
+		extract(OUTPUT_REDUCED_COSTS);
+		return reducedCosts_;
+	}
+	throw "solve unsuccessful; unable to retrieve reduced_costs";
 }
 
-void GurobiCommon::warmStart(GurobiCommon::WarmStatus warmStatus)
+const VectorXd& GurobiCommon::slack_ineq() const
 {
-	using ut = std::underlying_type<GurobiCommon::WarmStatus>::type;
-	model_.set(GRB_IntParam_MultiObjMethod, static_cast<ut>(warmStatus));
+	if (quality_ != SolutionQuality::NONE) {
+		extract(OUTPUT_SLACKS);
+		return slackIneq_;
+	}
+	throw "solve unsuccessful; unable to retrieve slack_ineq";
 }
 
-std::string GurobiCommon::statusDescription() const
+const VectorXi& GurobiCommon::basis_var() const
 {
-	switch(status_)
-	{
-		case GRB_LOADED:
-			return "Model is loaded, but no solution information is available.";
-		case GRB_OPTIMAL:
-			return "Model was solved to optimality (subject to tolerances), and an optimal solution is available.";
-		case GRB_INFEASIBLE:
-			return "Model was proven to be infeasible.";
-		case GRB_INF_OR_UNBD:
-			return "Model was proven to be either infeasible or unbounded. To obtain a more definitive conclusion,"
-				   " set the DualReductions parameter to 0 and reoptimize.";
-		case GRB_UNBOUNDED:
-			return "Model was proven to be unbounded. "
-					"Important note: an unbounded status indicates the presence of an unbounded ray that allows the objective to improve without limit. "
-					"It says nothing about whether the model has a feasible solution. "
-					"If you require information on feasibility, you should set the objective to zero and reoptimize.";
-		case GRB_CUTOFF:
-			return "Optimal objective for model was proven to be worse than the value specified in the Cutoff parameter. "
+	if (quality_ != SolutionQuality::NONE) {
+		extract(OUTPUT_BASIS);
+		return vbasis_;
+	}
+	throw "solve unsuccessful; unable to retrieve basis_var";
+}
+
+const VectorXi& GurobiCommon::basis_eq() const
+{
+	basis_var();
+	return eqbasis_;
+}
+
+const VectorXi& GurobiCommon::basis_ineq() const
+{
+	basis_var();
+	return ineqbasis_;
+}
+
+int GurobiCommon::extraction() const
+{
+	return extraction_;
+}
+
+void GurobiCommon::extraction(int outputs)
+{
+	extraction_ = outputs | OUTPUT_PRIMAL;
+}
+
+GurobiCommon::SolutionQuality GurobiCommon::solutionQuality() const noexcept
+{
+	return quality_;
+}
+
+GurobiCommon::ResultPolicy GurobiCommon::resultPolicy() const
+{
+	return resultPolicy_;
+}
+
+void GurobiCommon::resultPolicy(GurobiCommon::ResultPolicy policy)
+{
+	resultPolicy_ = policy;
+}
+
+void GurobiCommon::result(Ref<VectorXd> X) const
+{
+	X = result();
+}
+
+void GurobiCommon::dual_eq(Ref<VectorXd> Yeq) const
+{
+	Yeq = dual_eq();
+}
+
+void GurobiCommon::dual_ineq(Ref<VectorXd> Yineq) const
+{
+	Yineq = dual_ineq();
+}
+
+GurobiCommon::WarmStatus GurobiCommon::warmStart() const
+{
+	return warmStatus_;
+}
+
+void GurobiCommon::warmStart(GurobiCommon::WarmStatus warmStatus)
+{
+	warmStatus_ = warmStatus;
+	if (warmStatus_ != WarmStatus::BASIS)
+	{
+		hasBasis_ = false;
+	}
+}
+
+void GurobiCommon::warmStart(const VectorXd& X)
+{
+	assert(X.rows() == nrvar_);
+	startX_ = X;
+	userStart_ = 1;
+}
+
+void GurobiCommon::warmStart(const VectorXd& X, const VectorXd& Yeq, const VectorXd& Yineq)
+{
+	assert(X.rows() == nrvar_);
+	assert(Yeq.rows() == nreq_);
+	assert(Yineq.rows() == nrineq_);
+	startX_ = X;
+	startYeq_ = Yeq;
+	startYineq_ = Yineq;
+	userStart_ = 2;
+}
+
+std::string GurobiCommon::statusDescription() const
+{
+	switch(status_)
+	{
+		case GRB_LOADED:
+			return "Model is loaded, but no solution information is available.";
+		case GRB_OPTIMAL:
+			return "Model was solved to optimality (subject to tolerances), and an optimal solution is available.";
+		case GRB_INFEASIBLE:
+			return "Model was proven to be infeasible.";
+		case GRB_INF_OR_UNBD:
+			return "Model was proven to be either infeasible or unbounded. To obtain a more definitive conclusion,"
+				   " set the DualReductions parameter to 0 and reoptimize.";
+		case GRB_UNBOUNDED:
+			return "Model was proven to be unbounded. "
+					"Important note: an unbounded status indicates the presence of an unbounded ray that allows the objective to improve without limit. "
+					"It says nothing about whether the model has a feasible solution. "
+					"If you require information on feasibility, you should set the objective to zero and reoptimize.";
+		case GRB_CUTOFF:
+			return "Optimal objective for model was proven to be worse than the value specified in the Cutoff parameter. "
 				   "No solution information is available.";
 		case GRB_ITERATION_LIMIT:
 			return "Optimization terminated because the total number of simplex iterations performed exceeded the value specified in the IterationLimit parameter,"
@@ -145,273 +839,2848 @@ std::string GurobiCommon::statusDescription() const
 	}
 }
 
-void GurobiCommon::inform() const
+void GurobiCommon::inform() const
+{
+	std::cout << statusDescription() << std::endl;
+}
+
+void GurobiCommon::displayOutput(bool doDisplay)
+{
+	model_.set(GRB_IntParam_OutputFlag, doDisplay);
+}
+
+const std::shared_ptr<GRBEnv>& GurobiCommon::env() const
+{
+	return env_;
+}
+
+int GurobiCommon::threads() const
+{
+	return model_.get(GRB_IntParam_Threads);
+}
+
+void GurobiCommon::threads(int nrThreads)
+{
+	assert(nrThreads >= 0);
+	model_.set(GRB_IntParam_Threads, nrThreads);
+}
+
+GurobiCommon::Method GurobiCommon::method() const
+{
+	return static_cast<Method>(model_.get(GRB_IntParam_Method));
+}
+
+void GurobiCommon::method(GurobiCommon::Method m)
+{
+	model_.set(GRB_IntParam_Method, static_cast<int>(m));
+}
+
+GurobiCommon::Presolve GurobiCommon::presolve() const
+{
+	return static_cast<Presolve>(model_.get(GRB_IntParam_Presolve));
+}
+
+void GurobiCommon::presolve(GurobiCommon::Presolve level)
+{
+	model_.set(GRB_IntParam_Presolve, static_cast<int>(level));
+}
+
+int GurobiCommon::crossover() const
+{
+	return model_.get(GRB_IntParam_Crossover);
+}
+
+void GurobiCommon::crossover(int strategy)
+{
+	assert(-1 <= strategy && strategy <= 4);
+	model_.set(GRB_IntParam_Crossover, strategy);
+}
+
+double GurobiCommon::barrierConvergenceTolerance() const
+{
+	return model_.get(GRB_DoubleParam_BarConvTol);
+}
+
+void GurobiCommon::barrierConvergenceTolerance(double tol)
+{
+	assert(1. >= tol && tol >= 0.);
+	model_.set(GRB_DoubleParam_BarConvTol, tol);
+}
+
+int GurobiCommon::scaleFlag() const
+{
+	return model_.get(GRB_IntParam_ScaleFlag);
+}
+
+void GurobiCommon::scaleFlag(int flag)
+{
+	assert(-1 <= flag && flag <= 3);
+	model_.set(GRB_IntParam_ScaleFlag, flag);
+}
+
+int GurobiCommon::numericFocus() const
+{
+	return model_.get(GRB_IntParam_NumericFocus);
+}
+
+void GurobiCommon::numericFocus(int focus)
+{
+	assert(0 <= focus && focus <= 3);
+	model_.set(GRB_IntParam_NumericFocus, focus);
+}
+
+GurobiCommon::SolverParameters GurobiCommon::parameters() const
+{
+	SolverParameters params;
+	params.method = method();
+	params.threads = threads();
+	params.presolve = presolve();
+	params.crossover = crossover();
+	params.barrierConvergenceTolerance = barrierConvergenceTolerance();
+	params.scaleFlag = scaleFlag();
+	params.numericFocus = numericFocus();
+	params.feasibilityTolerance = feasibilityTolerance();
+	params.optimalityTolerance = optimalityTolerance();
+	return params;
+}
+
+void GurobiCommon::parameters(const GurobiCommon::SolverParameters& params)
+{
+	method(params.method);
+	threads(params.threads);
+	presolve(params.presolve);
+	crossover(params.crossover);
+	barrierConvergenceTolerance(params.barrierConvergenceTolerance);
+	scaleFlag(params.scaleFlag);
+	numericFocus(params.numericFocus);
+	feasibilityTolerance(params.feasibilityTolerance);
+	optimalityTolerance(params.optimalityTolerance);
+}
+
+double GurobiCommon::timeLimit() const
+{
+	return model_.get(GRB_DoubleParam_TimeLimit);
+}
+
+void GurobiCommon::timeLimit(double seconds)
+{
+	assert(seconds >= 0.);
+	model_.set(GRB_DoubleParam_TimeLimit, seconds);
+}
+
+double GurobiCommon::iterationLimit() const
+{
+	return model_.get(GRB_DoubleParam_IterationLimit);
+}
+
+void GurobiCommon::iterationLimit(double nrIter)
+{
+	assert(nrIter >= 0.);
+	model_.set(GRB_DoubleParam_IterationLimit, nrIter);
+}
+
+int GurobiCommon::barrierIterationLimit() const
+{
+	return model_.get(GRB_IntParam_BarIterLimit);
+}
+
+void GurobiCommon::barrierIterationLimit(int nrIter)
+{
+	assert(nrIter >= 0);
+	model_.set(GRB_IntParam_BarIterLimit, nrIter);
+}
+
+double GurobiCommon::feasibilityTolerance() const
+{
+	return model_.get(GRB_DoubleParam_FeasibilityTol);
+}
+
+void GurobiCommon::feasibilityTolerance(double tol)
+{
+	assert(1e-2 >= tol && tol >= 1e-9);
+	model_.set(GRB_DoubleParam_FeasibilityTol, tol);
+}
+
+double GurobiCommon::optimalityTolerance() const
+{
+	return model_.get(GRB_DoubleParam_OptimalityTol);
+}
+
+void GurobiCommon::optimalityTolerance(double tol)
+{
+	assert(1e-2 >= tol && tol >= 1e-9);
+	model_.set(GRB_DoubleParam_OptimalityTol, tol);
+}
+
+void GurobiCommon::problem(int nrvar, int nreq, int nrineq)
+{
+	for(int i = 0; i < nrvar_; ++i)
+	{
+		model_.remove(vars_[i]);
+	}
+
+	for(int i = 0; i < nreq_; ++i)
+	{
+		model_.remove(eqconstr_[i]);
+	}
+
+	for(int i = 0; i < nrineq_; ++i)
+	{
+		model_.remove(ineqconstr_[i]);
+	}
+
+	for(GRBVar& s : rangevars_)
+	{
+		model_.remove(s);
+	}
+
+	nrvar_ = 0;
+	nreq_ = 0;
+	nrineq_ = 0;
+	vars_.clear();
+	eqconstr_.clear();
+	ineqconstr_.clear();
+	rangevars_.clear();
+	singletons_.clear();
+	ranged_ = false;
+
+	hasSolution_ = false;
+	hasDual_ = false;
+	hasBasis_ = false;
+	userStart_ = 0;
+	quality_ = SolutionQuality::NONE;
+
+	// Q_ is only allocated by the solvers caching the dense Hessian
+	Q_.resize(0, 0);
+
+	C_.resize(nrvar);
+	Beq_.resize(nreq);
+	Bineq_.resize(nrineq);
+	X_.resize(nrvar);
+	Yeq_.resize(nreq);
+	Yineq_.resize(nrineq);
+
+	appendVars(nrvar);
+	appendConstrs(eqconstr_, nreq_, nreq, '=');
+	appendConstrs(ineqconstr_, nrineq_, nrineq, '<');
+}
+
+void GurobiCommon::addVariables(int nrvar)
+{
+	assert(nrvar >= 0);
+	const int oldNrvar = nrvar_;
+	appendVars(nrvar);
+
+	// New variables have no objective and no coefficients, with bounds [0, inf]
+	growRows(Q_, oldNrvar, nrvar_, 0.);
+	growCols(Q_, oldNrvar, nrvar_, 0.);
+	growRows(C_, oldNrvar, nrvar_, 0.);
+	growRows(XL_, oldNrvar, nrvar_, 0.);
+	growRows(XU_, oldNrvar, nrvar_, GRB_INFINITY);
+	growRows(X_, oldNrvar, nrvar_, 0.);
+	growRows(vbasis_, oldNrvar, nrvar_, GRB_NONBASIC_LOWER);
+	userStart_ = 0;
+}
+
+void GurobiCommon::removeVariables(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	const int nrvar = indexMap(nrvar_, indices, map);
+	for(int i = 0; i < nrvar_; ++i)
+	{
+		if(map[static_cast<size_t>(i)] < 0)
+		{
+			model_.remove(vars_[i]);
+		}
+	}
+
+	eraseRows(vars_, map, nrvar);
+	eraseRows(Q_, map, nrvar);
+	eraseCols(Q_, map, nrvar);
+	eraseRows(C_, map, nrvar);
+	eraseRows(XL_, map, nrvar);
+	eraseRows(XU_, map, nrvar);
+	eraseRows(X_, map, nrvar);
+	eraseRows(vbasis_, map, nrvar);
+	nrvar_ = nrvar;
+	userStart_ = 0;
+	singletons_.clear();
+}
+
+void GurobiCommon::addEqualities(int nreq)
+{
+	assert(nreq >= 0);
+	addConstraints(eqconstr_, Beq_, Yeq_, eqbasis_, nreq_, nreq, '=');
+}
+
+void GurobiCommon::removeEqualities(const std::vector<int>& indices)
+{
+	removeConstraints(eqconstr_, Beq_, Yeq_, eqbasis_, nreq_, indices);
+}
+
+void GurobiCommon::addInequalities(int nrineq)
+{
+	assert(nrineq >= 0);
+	const int oldNrineq = nrineq_;
+	addConstraints(ineqconstr_, Bineq_, Yineq_, ineqbasis_, nrineq_, nrineq, '<');
+	if (ranged_)
+	{
+		appendRangeVars(oldNrineq);
+	}
+}
+
+void GurobiCommon::removeInequalities(const std::vector<int>& indices)
+{
+	if (ranged_)
+	{
+		std::vector<int> map;
+		const int nrineq = indexMap(nrineq_, indices, map);
+		for(int i = 0; i < nrineq_; ++i)
+		{
+			if(map[static_cast<size_t>(i)] < 0)
+			{
+				model_.remove(rangevars_[static_cast<size_t>(i)]);
+			}
+		}
+		eraseRows(rangevars_, map, nrineq);
+		eraseRows(BineqL_, map, nrineq);
+		eraseRows(BineqU_, map, nrineq);
+		eraseRows(rangeX_, map, nrineq);
+		eraseRows(rangebasis_, map, nrineq);
+		singletons_.clear();
+	}
+	removeConstraints(ineqconstr_, Bineq_, Yineq_, ineqbasis_, nrineq_, indices);
+}
+
+void GurobiCommon::rangeInequalities(bool ranged)
+{
+	if (ranged == ranged_)
+	{
+		return;
+	}
+
+	ScopedTimer timer(collectStats_, stats_.constraintsTime);
+	if (ranged)
+	{
+		BineqL_.resize(0);
+		BineqU_.resize(0);
+		rangeX_.resize(0);
+		rangebasis_.resize(0);
+		ranged_ = true;
+		appendRangeVars(0);
+		rangeCached_ = false;
+	}
+	else
+	{
+		for(GRBVar& s : rangevars_)
+		{
+			model_.remove(s);
+		}
+		rangevars_.clear();
+		singletons_.clear();
+
+		std::vector<char> senses(static_cast<size_t>(nrineq_), '<');
+		model_.set(GRB_CharAttr_Sense, ineqconstr_.data(), senses.data(), nrineq_);
+		++stats_.apiCalls;
+		ranged_ = false;
+	}
+	// The basis of the other form does not apply
+	hasBasis_ = false;
+}
+
+void GurobiCommon::appendRangeVars(int first)
+{
+	const int nr = nrineq_ - first;
+	growRows(BineqL_, first, nrineq_, -GRB_INFINITY);
+	growRows(BineqU_, first, nrineq_, GRB_INFINITY);
+	growRows(rangeX_, first, nrineq_, 0.);
+	growRows(rangebasis_, first, nrineq_, GRB_BASIC);
+	if (nr <= 0)
+	{
+		return;
+	}
+
+	// New range rows are free, with a basic slack and a null right hand side
+	std::vector<double> lb(static_cast<size_t>(nr), -GRB_INFINITY);
+	std::vector<double> ub(static_cast<size_t>(nr), GRB_INFINITY);
+	GRBVar* vars = model_.addVars(lb.data(), ub.data(), nullptr, nullptr, nullptr, nr);
+	rangevars_.insert(rangevars_.end(), vars, vars + nr);
+	delete[] vars;
+
+	std::vector<double> coeffs(static_cast<size_t>(nr), -1.);
+	std::vector<double> zeros(static_cast<size_t>(nr), 0.);
+	std::vector<char> senses(static_cast<size_t>(nr), '=');
+	model_.chgCoeffs(ineqconstr_.data() + first, rangevars_.data() + first, coeffs.data(), nr);
+	model_.set(GRB_CharAttr_Sense, ineqconstr_.data() + first, senses.data(), nr);
+	model_.set(GRB_DoubleAttr_RHS, ineqconstr_.data() + first, zeros.data(), nr);
+	stats_.apiCalls += 4;
+
+	Bineq_.conservativeResize(nrineq_);
+	Bineq_.tail(nr).setZero();
+	if (ineqbasis_.rows() == nrineq_)
+	{
+		ineqbasis_.tail(nr).setConstant(GRB_NONBASIC_LOWER);
+	}
+}
+
+void GurobiCommon::boundSingletons(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU,
+	const Ref<const VectorXd>& L, const Ref<const VectorXd>& U)
+{
+	singletonXL_ = XL;
+	singletonXU_ = XU;
+	singletonL_ = L;
+	singletonU_ = U;
+	for(Singleton& s : singletons_)
+	{
+		double lower = L(s.row)/s.coeff;
+		double upper = U(s.row)/s.coeff;
+		if (s.coeff < 0.)
+		{
+			std::swap(lower, upper);
+		}
+		singletonXL_(s.var) = std::max(singletonXL_(s.var), lower);
+		singletonXU_(s.var) = std::min(singletonXU_(s.var), upper);
+		singletonL_(s.row) = -GRB_INFINITY;
+		singletonU_(s.row) = GRB_INFINITY;
+	}
+	if (singletons_.empty())
+	{
+		return;
+	}
+
+	// The first row giving the bound of a variable owns it, for the duals
+	singletonOwned_.assign(static_cast<size_t>(nrvar_), 0);
+	for(Singleton& s : singletons_)
+	{
+		double lower = (s.coeff > 0. ? L(s.row) : U(s.row))/s.coeff;
+		double upper = (s.coeff > 0. ? U(s.row) : L(s.row))/s.coeff;
+		char& own = singletonOwned_[static_cast<size_t>(s.var)];
+		s.lower = !(own & 1) && lower > XL(s.var) && lower == singletonXL_(s.var);
+		s.upper = !(own & 2) && upper < XU(s.var) && upper == singletonXU_(s.var);
+		own = static_cast<char>(own | (s.lower ? 1 : 0) | (s.upper ? 2 : 0));
+	}
+}
+
+void GurobiCommon::updateRanges(const Ref<const VectorXd>& L, const Ref<const VectorXd>& U)
+{
+	assert(L.rows() == nrineq_ && U.rows() == nrineq_);
+
+	ScopedTimer timer(collectStats_, stats_.boundsTime);
+	updateChanged(GRB_DoubleAttr_LB, rangevars_.data(), BineqL_, L, rangeCached_);
+	updateChanged(GRB_DoubleAttr_UB, rangevars_.data(), BineqU_, U, rangeCached_);
+	rangeCached_ = true;
+}
+
+void GurobiCommon::singletonDuals() const
+{
+	// The multiplier of an active variable bound set by the row a x_j <= u
+	// is the one of the row scaled by a
+	for(const Singleton& s : singletons_)
+	{
+		const double rc = vars_[s.var].get(GRB_DoubleAttr_RC);
+		const bool active = (rc > 0. && s.lower) || (rc < 0. && s.upper);
+		Yineq_(s.row) = active ? rc/s.coeff : 0.;
+	}
+}
+
+template<typename T, typename Attr, typename Handle>
+int GurobiCommon::getAttr(Attr attr, const Handle* handles, int len, T* out) const
+{
+	if (elementwiseAttr_ || len <= elementwiseAttrMax_)
+	{
+		for(int i = 0; i < len; ++i)
+		{
+			out[i] = handles[i].get(attr);
+		}
+		return len;
+	}
+
+	// The array getters do not modify the model but are not const
+	const auto* values = const_cast<GRBModel&>(model_).get(attr, handles, len);
+	std::copy(values, values + len, out);
+	delete[] values;
+	return 1;
+}
+
+int GurobiCommon::extract(int outputs) const
+{
+	const int missing = outputs & ~extracted_;
+	if (missing == 0)
+	{
+		return 0;
+	}
+
+	int calls = 0;
+	try
+	{
+		if ((missing & OUTPUT_DUAL) && hasDual_)
+		{
+			Yeq_.resize(nreq_);
+			Yineq_.resize(nrineq_);
+			calls += getAttr(GRB_DoubleAttr_Pi, eqconstr_.data(), nreq_, Yeq_.data());
+			calls += getAttr(GRB_DoubleAttr_Pi, ineqconstr_.data(), nrineq_, Yineq_.data());
+			singletonDuals();
+			calls += static_cast<int>(singletons_.size());
+			extracted_ |= OUTPUT_DUAL;
+		}
+		if ((missing & OUTPUT_REDUCED_COSTS) && hasDual_)
+		{
+			reducedCosts_.resize(nrvar_);
+			calls += getAttr(GRB_DoubleAttr_RC, vars_.data(), nrvar_, reducedCosts_.data());
+			extracted_ |= OUTPUT_REDUCED_COSTS;
+		}
+		if (missing & OUTPUT_SLACKS)
+		{
+			slackIneq_.resize(nrineq_);
+			if (ranged_)
+			{
+				// The range rows are equalities, the slack variables hold A x
+				slackIneq_ = BineqU_ - rangeX_;
+			}
+			else
+			{
+				calls += getAttr(GRB_DoubleAttr_Slack, ineqconstr_.data(), nrineq_, slackIneq_.data());
+			}
+			extracted_ |= OUTPUT_SLACKS;
+		}
+		if (missing & OUTPUT_BASIS)
+		{
+			vbasis_.resize(nrvar_);
+			eqbasis_.resize(nreq_);
+			ineqbasis_.resize(nrineq_);
+			calls += getAttr(GRB_IntAttr_VBasis, vars_.data(), nrvar_, vbasis_.data());
+			calls += getAttr(GRB_IntAttr_CBasis, eqconstr_.data(), nreq_, eqbasis_.data());
+			calls += getAttr(GRB_IntAttr_CBasis, ineqconstr_.data(), nrineq_, ineqbasis_.data());
+			extracted_ |= OUTPUT_BASIS;
+		}
+	}
+	catch(const GRBException&)
+	{
+		throw "the outputs of the last solve are no longer available";
+	}
+	return calls;
+}
+
+template<typename Handle>
+void GurobiCommon::updateChanged(GRB_DoubleAttr attr, const Handle* handles, VectorXd& cache,
+	const Ref<const VectorXd>& value, bool cached)
+{
+	const int len = static_cast<int>(value.rows());
+	if (!cached || cache.rows() != len)
+	{
+		if (len > 0)
+		{
+			model_.set(attr, handles, value.data(), len);
+			++stats_.apiCalls;
+		}
+		cache = value;
+		return;
+	}
+
+	if (value == cache)
+	{
+		return;
+	}
+
+	// Ranges separated by a few unchanged entries are sent together
+	const int maxGap = 16;
+	int i = 0;
+	while (i < len)
+	{
+		if (value(i) == cache(i))
+		{
+			++i;
+			continue;
+		}
+
+		const int start = i;
+		int end = i + 1;
+		for(i = end; i < len && i - end < maxGap; ++i)
+		{
+			if (value(i) != cache(i))
+			{
+				end = i + 1;
+			}
+		}
+		model_.set(attr, handles + start, value.data() + start, end - start);
+		cache.segment(start, end - start) = value.segment(start, end - start);
+		++stats_.apiCalls;
+		i = end;
+	}
+}
+
+void GurobiCommon::storeInstance(Index k, Ref<MatrixXd> X, std::vector<int>& status) const
+{
+	status[static_cast<size_t>(k)] = status_;
+	if (success())
+	{
+		X.col(k) = X_;
+	}
+	else
+	{
+		X.col(k).setConstant(std::numeric_limits<double>::quiet_NaN());
+	}
+}
+
+void GurobiCommon::appendVars(int nrvar)
+{
+	GRBVar* vars = model_.addVars(nrvar, GRB_CONTINUOUS);
+	vars_.insert(vars_.end(), vars, vars+nrvar);
+	delete[] vars;
+	nrvar_ += nrvar;
+}
+
+void GurobiCommon::appendConstrs(std::vector<GRBConstr>& constrs, int& len,
+	int nrconstr, char sense)
+{
+	GRBConstr* added = model_.addConstrs(nrconstr);
+	std::vector<char> senses(static_cast<size_t>(nrconstr), sense);
+	model_.set(GRB_CharAttr_Sense, added, senses.data(), nrconstr);
+	constrs.insert(constrs.end(), added, added+nrconstr);
+	delete[] added;
+	len += nrconstr;
+	colvars_.resize(static_cast<size_t>(std::max(nreq_, nrineq_)));
+}
+
+void GurobiCommon::addConstraints(std::vector<GRBConstr>& constrs, VectorXd& b,
+	VectorXd& y, VectorXi& basis, int& len, int nrconstr, char sense)
+{
+	const int oldLen = len;
+	appendConstrs(constrs, len, nrconstr, sense);
+
+	// New constraints have no coefficients, a null right hand side and a
+	// basic slack
+	growRows(b, oldLen, len, 0.);
+	growRows(y, oldLen, len, 0.);
+	growRows(basis, oldLen, len, GRB_BASIC);
+	userStart_ = 0;
+}
+
+void GurobiCommon::removeConstraints(std::vector<GRBConstr>& constrs, VectorXd& b,
+	VectorXd& y, VectorXi& basis, int& len, const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	const int newLen = indexMap(len, indices, map);
+	for(int i = 0; i < len; ++i)
+	{
+		if(map[static_cast<size_t>(i)] < 0)
+		{
+			model_.remove(constrs[static_cast<size_t>(i)]);
+		}
+	}
+
+	eraseRows(constrs, map, newLen);
+	eraseRows(b, map, newLen);
+	eraseRows(y, map, newLen);
+	eraseRows(basis, map, newLen);
+	len = newLen;
+	userStart_ = 0;
+}
+
+void GurobiCommon::setVariableType(int varIndex, char GRBType) {
+    vars_[varIndex].set(GRB_CharAttr_VType, GRBType);
+}
+
+void GurobiCommon::setVariableTypes(const Ref<const VectorXi>& indices,
+	const std::vector<char>& GRBTypes)
+{
+	assert(static_cast<size_t>(indices.size()) == GRBTypes.size());
+
+	std::vector<GRBVar> vars(static_cast<size_t>(indices.size()));
+	for(Index i = 0; i < indices.size(); ++i)
+	{
+		assert(0 <= indices(i) && indices(i) < nrvar_);
+		vars[static_cast<size_t>(i)] = vars_[indices(i)];
+	}
+	model_.set(GRB_CharAttr_VType, vars.data(), GRBTypes.data(), static_cast<int>(vars.size()));
+}
+
+void GurobiCommon::setVariableTypes(const Ref<const VectorXi>& indices, char GRBType)
+{
+	setVariableTypes(indices, std::vector<char>(static_cast<size_t>(indices.size()), GRBType));
+}
+
+double GurobiCommon::mipGap() const
+{
+	return model_.get(GRB_DoubleAttr_MIPGap);
+}
+
+double GurobiCommon::objBound() const
+{
+	return model_.get(GRB_DoubleAttr_ObjBound);
+}
+
+int GurobiCommon::solutionCount() const
+{
+	return model_.get(GRB_IntAttr_SolCount);
+}
+
+double GurobiCommon::poolSolution(int solNumber, Ref<VectorXd> X)
+{
+	assert(0 <= solNumber && solNumber < solutionCount());
+	assert(X.rows() == nrvar_);
+
+	model_.set(GRB_IntParam_SolutionNumber, solNumber);
+	getAttr(GRB_DoubleAttr_Xn, vars_.data(), nrvar_, X.data());
+	return model_.get(GRB_DoubleAttr_PoolObjVal);
+}
+
+void GurobiCommon::applyWarmStart()
+{
+	bool primal = false;
+	bool dual = false;
+	const VectorXd* X = &X_;
+	const VectorXd* Yeq = &Yeq_;
+	const VectorXd* Yineq = &Yineq_;
+
+	if (userStart_ > 0)
+	{
+		primal = true;
+		dual = userStart_ > 1;
+		X = &startX_;
+		Yeq = &startYeq_;
+		Yineq = &startYineq_;
+		userStart_ = 0;
+	}
+	else
+	{
+		switch(warmStatus_)
+		{
+			case WarmStatus::NONE:
+				model_.reset();
+				return;
+			case WarmStatus::PRIMAL:
+				primal = hasSolution_;
+				break;
+			case WarmStatus::DUAL:
+				dual = hasSolution_ && (extracted_ & OUTPUT_DUAL);
+				break;
+			case WarmStatus::PRIMAL_DUAL:
+				primal = hasSolution_;
+				dual = hasSolution_ && (extracted_ & OUTPUT_DUAL);
+				break;
+			case WarmStatus::BASIS:
+				if (hasBasis_)
+				{
+					model_.set(GRB_IntAttr_VBasis, vars_.data(), vbasis_.data(), nrvar_);
+					model_.set(GRB_IntAttr_CBasis, eqconstr_.data(), eqbasis_.data(), nreq_);
+					model_.set(GRB_IntAttr_CBasis, ineqconstr_.data(), ineqbasis_.data(), nrineq_);
+					if (ranged_)
+					{
+						model_.set(GRB_IntAttr_VBasis, rangevars_.data(), rangebasis_.data(), nrineq_);
+					}
+				}
+				return;
+			default:
+				return;
+		}
+	}
+
+	if (primal)
+	{
+		model_.set(GRB_DoubleAttr_PStart, vars_.data(), X->data(), nrvar_);
+		// The slacks of a user start are left to Gurobi
+		if (ranged_ && X == &X_)
+		{
+			model_.set(GRB_DoubleAttr_PStart, rangevars_.data(), rangeX_.data(), nrineq_);
+		}
+		if (model_.get(GRB_IntAttr_IsMIP))
+		{
+			model_.set(GRB_DoubleAttr_Start, vars_.data(), X->data(), nrvar_);
+		}
+	}
+	if (dual)
+	{
+		model_.set(GRB_DoubleAttr_DStart, eqconstr_.data(), Yeq->data(), nreq_);
+		model_.set(GRB_DoubleAttr_DStart, ineqconstr_.data(), Yineq->data(), nrineq_);
+	}
+}
+
+void GurobiCommon::saveBasis()
+{
+	hasBasis_ = false;
+
+	// A basis is only available if the model was solved with simplex
+	// (or barrier with crossover)
+	try
+	{
+		stats_.apiCalls += extract(OUTPUT_BASIS);
+		if (ranged_)
+		{
+			rangebasis_.resize(nrineq_);
+			stats_.apiCalls += getAttr(GRB_IntAttr_VBasis, rangevars_.data(), nrineq_, rangebasis_.data());
+		}
+		hasBasis_ = true;
+	}
+	catch(const GRBException&)
+	{
+	}
+	catch(const char*)
+	{
+	}
+}
+
+bool GurobiCommon::optimize()
+{
+	startOptimize();
+
+	{
+		ScopedTimer timer(collectStats_, stats_.optimizeTime);
+		model_.optimize();
+		++stats_.apiCalls;
+	}
+
+	return finishOptimize();
+}
+
+GurobiCommon::SolveResult GurobiCommon::tryOptimize() noexcept
+{
+	return guardedSolve([this]() { optimize(); });
+}
+
+void GurobiCommon::solveFailed(int error) noexcept
+{
+	// The warm start information of the previous solves is kept
+	error_ = error;
+	status_ = GRB_LOADED;
+	quality_ = SolutionQuality::NONE;
+	hasDual_ = false;
+}
+
+GurobiCommon::AsyncSolve GurobiCommon::optimizeAsync()
+{
+	startOptimize();
+	model_.optimizeasync();
+	++stats_.apiCalls;
+	status_ = GRB_INPROGRESS;
+
+	return AsyncSolve(this);
+}
+
+void GurobiCommon::startOptimize()
+{
+	quality_ = SolutionQuality::NONE;
+	hasDual_ = false;
+	// The model is up to date for the warm start queries, the warm start
+	// itself is applied by the optimization
+	commitStaged();
+	commit();
+	applyWarmStart();
+
+	if (progressCallback_)
+	{
+		progress_ = Progress();
+		incumbent_.resize(nrvar_);
+	}
+}
+
+void GurobiCommon::commitStaged()
+{ }
+
+void GurobiCommon::commit()
+{
+	ScopedTimer timer(collectStats_, stats_.updateTime);
+	model_.update();
+	++stats_.apiCalls;
+}
+
+bool GurobiCommon::finishOptimize()
+{
+	bool isMip = false;
+	{
+		ScopedTimer timer(collectStats_, stats_.extractionTime);
+		status_ = model_.get(GRB_IntAttr_Status);
+		iter_ = model_.get(GRB_IntAttr_BarIterCount);
+		isMip = model_.get(GRB_IntAttr_IsMIP) != 0;
+		stats_.apiCalls += 3;
+		extracted_ = OUTPUT_PRIMAL;
+		if (success()) {
+			// X_ is allocated by problem()
+			stats_.apiCalls += getAttr(GRB_DoubleAttr_X, vars_.data(), nrvar_, X_.data());
+			if (ranged_)
+			{
+				stats_.apiCalls += getAttr(GRB_DoubleAttr_X, rangevars_.data(), nrineq_, rangeX_.data());
+			}
+			// Gurobi has no duals for models with integer variables, the other
+			// outputs are queried when needed
+			hasDual_ = !isMip;
+			int outputs = extraction_;
+			if (warmStatus_ == WarmStatus::DUAL || warmStatus_ == WarmStatus::PRIMAL_DUAL)
+			{
+				outputs |= OUTPUT_DUAL;
+			}
+			stats_.apiCalls += extract(outputs & ~OUTPUT_BASIS);
+			hasSolution_ = true;
+			quality_ = status_ == GRB_OPTIMAL ? SolutionQuality::OPTIMAL : SolutionQuality::SUBOPTIMAL;
+
+			if (warmStatus_ == WarmStatus::BASIS || (extraction_ & OUTPUT_BASIS))
+			{
+				saveBasis();
+			}
+		}
+		else if (resultPolicy_ == ResultPolicy::BEST_AVAILABLE && isLimitStatus(status_)
+			&& model_.get(GRB_IntAttr_SolCount) > 0)
+		{
+			// The solution count and the incumbent
+			stats_.apiCalls += 1 + getAttr(GRB_DoubleAttr_X, vars_.data(), nrvar_, X_.data());
+			if (ranged_)
+			{
+				stats_.apiCalls += getAttr(GRB_DoubleAttr_X, rangevars_.data(), nrineq_, rangeX_.data());
+			}
+			quality_ = SolutionQuality::INCUMBENT;
+
+			// The duals are only available for some continuous models
+			try
+			{
+				if (!isMip)
+				{
+					stats_.apiCalls += getAttr(GRB_DoubleAttr_Pi, eqconstr_.data(), nreq_, Yeq_.data());
+					stats_.apiCalls += getAttr(GRB_DoubleAttr_Pi, ineqconstr_.data(), nrineq_, Yineq_.data());
+					singletonDuals();
+					hasDual_ = true;
+					extracted_ |= OUTPUT_DUAL;
+					quality_ = SolutionQuality::INCUMBENT_DUAL;
+				}
+			}
+			catch(const GRBException&)
+			{
+			}
+		}
+	}
+
+	if (collectStats_)
+	{
+		stats_.runtime = model_.get(GRB_DoubleAttr_Runtime);
+		stats_.simplexIterations = model_.get(GRB_DoubleAttr_IterCount);
+		stats_.barrierIterations = iter_;
+		if (isMip)
+		{
+			stats_.nodeCount = model_.get(GRB_DoubleAttr_NodeCount);
+		}
+	}
+	lastStats_ = stats_;
+	stats_.reset();
+
+	return success();
+}
+
+bool GurobiCommon::collectStats() const
+{
+	return collectStats_;
+}
+
+void GurobiCommon::collectStats(bool doCollect)
+{
+	collectStats_ = doCollect;
+}
+
+const GurobiCommon::SolveStats& GurobiCommon::stats() const
+{
+	return lastStats_;
+}
+
+GurobiCommon::MemoryUsage GurobiCommon::memoryUsage() const
+{
+	MemoryUsage usage;
+	usage.wrapper = bytes(Q_) + bytes(C_) + bytes(Beq_) + bytes(Bineq_) + bytes(XL_) + bytes(XU_)
+		+ bytes(X_) + bytes(Yeq_) + bytes(Yineq_) + bytes(reducedCosts_) + bytes(slackIneq_)
+		+ bytes(startX_) + bytes(startYeq_) + bytes(startYineq_)
+		+ bytes(vbasis_) + bytes(eqbasis_) + bytes(ineqbasis_)
+		+ bytes(vars_) + bytes(colvars_) + bytes(eqconstr_) + bytes(ineqconstr_)
+		+ bytes(rangevars_) + bytes(BineqL_) + bytes(BineqU_) + bytes(rangeX_) + bytes(rangebasis_)
+		+ bytes(singletons_);
+	usage.scratch = bytes(singletonXL_) + bytes(singletonXU_) + bytes(singletonL_) + bytes(singletonU_)
+		+ bytes(singletonOwned_) + bytes(incumbent_) + bytes(zeroConstrs_) + bytes(zeroVars_) + bytes(zeros_);
+
+#if GRB_VERSION_MAJOR > 9 || (GRB_VERSION_MAJOR == 9 && GRB_VERSION_MINOR >= 5)
+	usage.gurobi = model_.get(GRB_DoubleAttr_MemUsed);
+	usage.gurobiPeak = model_.get(GRB_DoubleAttr_MaxMemUsed);
+#else
+	usage.gurobi = 0.;
+	usage.gurobiPeak = 0.;
+#endif
+	return usage;
+}
+
+void GurobiCommon::compact()
+{
+	singletonXL_.resize(0);
+	singletonXU_.resize(0);
+	singletonL_.resize(0);
+	singletonU_.resize(0);
+	release(singletonOwned_);
+	release(zeroConstrs_);
+	release(zeroVars_);
+	release(zeros_);
+	if (!progressCallback_)
+	{
+		incumbent_.resize(0);
+	}
+	// The starts are only used by the next solve
+	if (userStart_ == 0)
+	{
+		startX_.resize(0);
+		startYeq_.resize(0);
+		startYineq_.resize(0);
+	}
+}
+
+const std::shared_ptr<GurobiRecorder>& GurobiCommon::recorder() const
+{
+	return recorder_;
+}
+
+void GurobiCommon::recorder(std::shared_ptr<GurobiRecorder> recorder)
+{
+	recorder_ = std::move(recorder);
+}
+
+void GurobiCommon::progressCallback(ProgressCallback callback)
+{
+	progressCallback_ = std::move(callback);
+	if (progressCallback_)
+	{
+		if (!progressAdapter_)
+		{
+			progressAdapter_.reset(new ProgressAdapter(*this));
+		}
+		model_.setCallback(progressAdapter_.get());
+	}
+	else
+	{
+		model_.setCallback(nullptr);
+	}
+}
+
+
+/**
+ * GurobiCommon::ProgressAdapter
+ */
+
+
+GurobiCommon::ProgressAdapter::ProgressAdapter(GurobiCommon& qp):
+	qp_(qp)
+{ }
+
+void GurobiCommon::ProgressAdapter::callback()
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	Progress& p = qp_.progress_;
+	p.newIncumbent = false;
+	switch(where)
+	{
+		case GRB_CB_SIMPLEX:
+			p.iterations = getDoubleInfo(GRB_CB_SPX_ITRCNT);
+			p.primalObjective = getDoubleInfo(GRB_CB_SPX_OBJVAL);
+			p.dualObjective = nan;
+			break;
+		case GRB_CB_BARRIER:
+			p.iterations = getIntInfo(GRB_CB_BARRIER_ITRCNT);
+			p.primalObjective = getDoubleInfo(GRB_CB_BARRIER_PRIMOBJ);
+			p.dualObjective = getDoubleInfo(GRB_CB_BARRIER_DUALOBJ);
+			break;
+		case GRB_CB_MIP:
+			p.iterations = getDoubleInfo(GRB_CB_MIP_NODCNT);
+			p.primalObjective = getDoubleInfo(GRB_CB_MIP_OBJBST);
+			p.dualObjective = getDoubleInfo(GRB_CB_MIP_OBJBND);
+			break;
+		case GRB_CB_MIPSOL:
+		{
+			// Copied one by one into the preallocated incumbent
+			VectorXd& X = qp_.incumbent_;
+			for(int i = 0; i < qp_.nrvar_; ++i)
+			{
+				X(i) = getSolution(qp_.vars_[i]);
+			}
+			p.primalObjective = getDoubleInfo(GRB_CB_MIPSOL_OBJBST);
+			p.dualObjective = getDoubleInfo(GRB_CB_MIPSOL_OBJBND);
+			p.newIncumbent = true;
+			p.hasIncumbent = true;
+			break;
+		}
+		default:
+			return;
+	}
+
+	p.where = where;
+	p.gap = std::abs(p.primalObjective - p.dualObjective)/std::max(std::abs(p.primalObjective), 1e-10);
+	p.runtime = getDoubleInfo(GRB_CB_RUNTIME);
+	if (!qp_.progressCallback_(p, qp_.incumbent_))
+	{
+		abort();
+	}
+}
+
+
+/**
+ * GurobiCommon::AsyncSolve
+ */
+
+
+GurobiCommon::AsyncSolve::AsyncSolve(GurobiCommon* qp):
+	qp_(qp)
+{
+}
+
+GurobiCommon::AsyncSolve::AsyncSolve(AsyncSolve&& other):
+	qp_(other.qp_)
+{
+	other.qp_ = nullptr;
+}
+
+GurobiCommon::AsyncSolve::~AsyncSolve()
+{
+	if (qp_ != nullptr)
+	{
+		// Nothing may leave a destructor: the errors of Gurobi and of the
+		// extraction of the outputs are dropped with the solve
+		try
+		{
+			cancel();
+		}
+		catch(...)
+		{
+		}
+	}
+}
+
+bool GurobiCommon::AsyncSolve::poll()
+{
+	if (qp_ == nullptr)
+	{
+		return true;
+	}
+	if (qp_->model_.get(GRB_IntAttr_Status) == GRB_INPROGRESS)
+	{
+		return false;
+	}
+	finish();
+	return true;
+}
+
+bool GurobiCommon::AsyncSolve::wait(double timeout)
+{
+	if (qp_ == nullptr)
+	{
+		return true;
+	}
+	if (timeout < 0.)
+	{
+		finish();
+		return true;
+	}
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point deadline = clock::now() +
+		std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(timeout));
+	while (!poll())
+	{
+		if (clock::now() >= deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	return true;
+}
+
+void GurobiCommon::AsyncSolve::cancel()
+{
+	if (qp_ != nullptr)
+	{
+		qp_->model_.terminate();
+		finish();
+	}
+}
+
+bool GurobiCommon::AsyncSolve::done() const
+{
+	return qp_ == nullptr;
+}
+
+void GurobiCommon::AsyncSolve::finish()
+{
+	GurobiCommon* qp = qp_;
+	qp_ = nullptr;
+	qp->model_.sync();
+	qp->finishOptimize();
+}
+
+
+void GurobiCommon::resetPattern(CoeffPattern& pattern)
+{
+	// New constraints have no coefficients
+	pattern.outer.assign(static_cast<size_t>(nrvar_+1), 0);
+	pattern.inner.clear();
+	pattern.constrs.clear();
+	pattern.vars.clear();
+	pattern.valid = true;
+	pattern.rhsValid = false;
+}
+
+void GurobiCommon::updateCoeffs(GRBConstr* constrs, CoeffPattern& pattern,
+			const SparseMatrix<double>& A, int len)
+{
+	assert(A.rows() == len);
+	assert(A.cols() == nrvar_);
+
+	if(len > 0)
+	{
+		if(!A.isCompressed())
+		{
+			SparseMatrix<double> Ac(A);
+			Ac.makeCompressed();
+			updateCoeffs(constrs, pattern, Ac, len);
+			return;
+		}
+
+		ScopedTimer timer(collectStats_, stats_.constraintsTime);
+		const int* outer = A.outerIndexPtr();
+		const int* inner = A.innerIndexPtr();
+		const int nnz = static_cast<int>(A.nonZeros());
+
+		bool samePattern = pattern.valid &&
+			static_cast<int>(pattern.inner.size()) == nnz &&
+			std::equal(pattern.outer.begin(), pattern.outer.end(), outer) &&
+			std::equal(pattern.inner.begin(), pattern.inner.end(), inner);
+
+		if(!samePattern)
+		{
+			zeroConstrs_.clear();
+			zeroVars_.clear();
+			if(pattern.valid)
+			{
+				// Only zero the coefficients that are no longer in the pattern
+				for(int k = 0; k < nrvar_; ++k)
+				{
+					int p = pattern.outer[static_cast<size_t>(k)];
+					int pend = pattern.outer[static_cast<size_t>(k+1)];
+					int q = outer[k];
+					for(; p < pend; ++p)
+					{
+						int row = pattern.inner[static_cast<size_t>(p)];
+						while(q < outer[k+1] && inner[q] < row)
+						{
+							++q;
+						}
+						if(q == outer[k+1] || inner[q] != row)
+						{
+							zeroConstrs_.push_back(*(constrs+row));
+							zeroVars_.push_back(vars_[k]);
+						}
+					}
+				}
+			}
+			else
+			{
+				// Unknown coefficients: zero every column
+				zeros_.assign(static_cast<size_t>(len), 0.0);
+				for(int k = 0; k < nrvar_; ++k)
+				{
+					std::fill(colvars_.begin(), colvars_.begin()+len, vars_[k]);
+					model_.chgCoeffs(constrs, colvars_.data(), zeros_.data(), len);
+				}
+				stats_.apiCalls += nrvar_;
+				stats_.coeffsChanged += static_cast<long>(nrvar_)*len;
+			}
+
+			pattern.valid = false;
+			if(!zeroConstrs_.empty())
+			{
+				zeros_.assign(zeroConstrs_.size(), 0.0);
+				model_.chgCoeffs(zeroConstrs_.data(), zeroVars_.data(), zeros_.data(),
+					static_cast<int>(zeroConstrs_.size()));
+				++stats_.apiCalls;
+				stats_.coeffsChanged += static_cast<long>(zeroConstrs_.size());
+			}
+
+			pattern.outer.assign(outer, outer+nrvar_+1);
+			pattern.inner.assign(inner, inner+nnz);
+			pattern.constrs.resize(static_cast<size_t>(nnz));
+			pattern.vars.resize(static_cast<size_t>(nnz));
+			for(int k = 0; k < nrvar_; ++k)
+			{
+				for(int p = outer[k]; p < outer[k+1]; ++p)
+				{
+					pattern.constrs[static_cast<size_t>(p)] = *(constrs+inner[p]);
+					pattern.vars[static_cast<size_t>(p)] = vars_[k];
+				}
+			}
+		}
+
+		//Update constrs, all the nonzeros in a single call
+		pattern.valid = false;
+		if(nnz > 0)
+		{
+			model_.chgCoeffs(pattern.constrs.data(), pattern.vars.data(), A.valuePtr(), nnz);
+			++stats_.apiCalls;
+			stats_.coeffsChanged += nnz;
+		}
+		pattern.valid = true;
+	}
+}
+
+
+/**
+ * GurobiDense
+ */
+
+
+GurobiDense::GurobiDense():
+	incrementalObj_(true),
+	objCached_(false),
+	hessianStructure_(HessianStructure::AUTO),
+	hessianBandwidth_(0),
+	dataCached_(false),
+	singletonsCached_(false),
+	staged_(0)
+{ }
+
+
+GurobiDense::GurobiDense(int nrvar, int nreq, int nrineq):
+	GurobiDense()
+{
+	problem(nrvar, nreq, nrineq);
+}
+
+
+GurobiDense::GurobiDense(std::shared_ptr<GRBEnv> env):
+	GurobiCommon(std::move(env)),
+	incrementalObj_(true),
+	objCached_(false),
+	hessianStructure_(HessianStructure::AUTO),
+	hessianBandwidth_(0),
+	dataCached_(false),
+	singletonsCached_(false),
+	staged_(0)
+{ }
+
+
+GurobiDense::GurobiDense(const std::string& path):
+	GurobiDense(std::make_shared<GRBEnv>(), path)
+{ }
+
+
+GurobiDense::GurobiDense(std::shared_ptr<GRBEnv> env, const std::string& path):
+	GurobiCommon(std::move(env), path),
+	incrementalObj_(true),
+	objCached_(false),
+	hessianStructure_(HessianStructure::AUTO),
+	hessianBandwidth_(0),
+	dataCached_(false),
+	singletonsCached_(false),
+	staged_(0)
+{
+	objVars_.reserve(static_cast<size_t>(nrvar_));
+	objVals_.reserve(static_cast<size_t>(nrvar_));
+}
+
+
+GurobiDense::GurobiDense(std::shared_ptr<GRBEnv> env, int nrvar, int nreq, int nrineq):
+	GurobiDense(std::move(env))
+{
+	problem(nrvar, nreq, nrineq);
+}
+
+
+void GurobiDense::problem(int nrvar, int nreq, int nrineq)
+{
+	GurobiCommon::problem(nrvar, nreq, nrineq);
+
+	objCached_ = false;
+	dataCached_ = false;
+	singletonsCached_ = false;
+	objVars_.reserve(static_cast<size_t>(nrvar));
+	objVals_.reserve(static_cast<size_t>(nrvar));
+}
+
+void GurobiDense::addVariables(int nrvar)
+{
+	const int oldNrvar = nrvar_;
+	GurobiCommon::addVariables(nrvar);
+
+	growCols(Aeq_, oldNrvar, nrvar_, 0.);
+	growCols(Aineq_, oldNrvar, nrvar_, 0.);
+	singletonsCached_ = false;
+	objVars_.reserve(static_cast<size_t>(nrvar_));
+	objVals_.reserve(static_cast<size_t>(nrvar_));
+}
+
+void GurobiDense::removeVariables(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	const int nrvar = indexMap(nrvar_, indices, map);
+	eraseCols(Aeq_, map, nrvar);
+	eraseCols(Aineq_, map, nrvar);
+	singletonsCached_ = false;
+
+	GurobiCommon::removeVariables(indices);
+}
+
+void GurobiDense::addEqualities(int nreq)
+{
+	const int oldNreq = nreq_;
+	GurobiCommon::addEqualities(nreq);
+
+	growRows(Aeq_, oldNreq, nreq_, 0.);
+}
+
+void GurobiDense::removeEqualities(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	const int nreq = indexMap(nreq_, indices, map);
+	eraseRows(Aeq_, map, nreq);
+
+	GurobiCommon::removeEqualities(indices);
+}
+
+void GurobiDense::addInequalities(int nrineq)
+{
+	const int oldNrineq = nrineq_;
+	GurobiCommon::addInequalities(nrineq);
+
+	growRows(Aineq_, oldNrineq, nrineq_, 0.);
+	singletonsCached_ = false;
+}
+
+void GurobiDense::removeInequalities(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	const int nrineq = indexMap(nrineq_, indices, map);
+	eraseRows(Aineq_, map, nrineq);
+	singletonsCached_ = false;
+
+	GurobiCommon::removeInequalities(indices);
+}
+
+bool GurobiDense::incrementalObjective() const
+{
+	return incrementalObj_;
+}
+
+void GurobiDense::incrementalObjective(bool incremental)
+{
+	incrementalObj_ = incremental;
+	objCached_ = false;
+}
+
+GurobiDense::HessianStructure GurobiDense::hessianStructure() const
+{
+	return hessianStructure_;
+}
+
+int GurobiDense::hessianBandwidth() const
+{
+	return hessianBandwidth_;
+}
+
+void GurobiDense::hessianStructure(GurobiDense::HessianStructure structure, int bandwidth)
+{
+	assert(bandwidth >= 0);
+	// The terms of the model were read under the previous structure
+	if (structure != hessianStructure_ || bandwidth != hessianBandwidth_)
+	{
+		objCached_ = false;
+	}
+	hessianStructure_ = structure;
+	hessianBandwidth_ = bandwidth;
+}
+
+void GurobiDense::updateObjective(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C)
+{
+	if (recorder_)
+	{
+		throw "objective updates cannot be recorded, use solve()";
+	}
+	sendObjective(Q, C);
+}
+
+void GurobiDense::sendObjective(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C)
+{
+	assert(Q.rows() == nrvar_ && Q.cols() == nrvar_);
+	assert(C.rows() == nrvar_);
+
+	if (incrementalObj_ && objCached_ && Q == Q_)
+	{
+		sendLinearObjective(C);
+		return;
+	}
+
+	ScopedTimer timer(collectStats_, stats_.objectiveTime);
+
+	HessianStructure structure = hessianStructure_;
+	if (structure == HessianStructure::AUTO)
+	{
+		bool diagonal = true;
+		bool symmetric = true;
+		for(int j = 0; j < nrvar_ && symmetric; ++j)
+		{
+			for(int i = 0; i < j; ++i)
+			{
+				diagonal = diagonal && Q(i, j) == 0. && Q(j, i) == 0.;
+				symmetric = symmetric && Q(i, j) == Q(j, i);
+			}
+		}
+		structure = diagonal ? HessianStructure::DIAGONAL :
+			(symmetric ? HessianStructure::SYMMETRIC : HessianStructure::GENERAL);
+	}
+
+	// Only the nonzero coefficients are given to Gurobi, in a single call
+	std::vector<double> qcoeffs;
+	std::vector<GRBVar> qvars1, qvars2;
+	auto addTerm = [&](double coeff, int i, int j)
+	{
+		if (coeff != 0.)
+		{
+			qcoeffs.push_back(coeff);
+			qvars1.push_back(vars_[i]);
+			qvars2.push_back(vars_[j]);
+		}
+	};
+
+	switch(structure)
+	{
+		case HessianStructure::DIAGONAL:
+			for(int i = 0; i < nrvar_; ++i)
+			{
+				addTerm(Q(i, i), i, i);
+			}
+			break;
+		case HessianStructure::SYMMETRIC:
+		case HessianStructure::BANDED:
+		{
+			// x_i Q_ij x_j + x_j Q_ji x_i = 2 Q_ij x_i x_j
+			const int band = structure == HessianStructure::BANDED ? hessianBandwidth_ : nrvar_;
+			for(int j = 0; j < nrvar_; ++j)
+			{
+				for(int i = std::max(0, j - band); i < j; ++i)
+				{
+					addTerm(2.*Q(i, j), i, j);
+				}
+				addTerm(Q(j, j), j, j);
+			}
+			break;
+		}
+		default:
+			for(int j = 0; j < nrvar_; ++j)
+			{
+				for(int i = 0; i < nrvar_; ++i)
+				{
+					addTerm(Q(i, j), i, j);
+				}
+			}
+			break;
+	}
+
+	GRBQuadExpr qexpr;
+	qexpr.addTerms(qcoeffs.data(), qvars1.data(), qvars2.data(), static_cast<int>(qcoeffs.size()));
+
+	GRBLinExpr lexpr;
+	lexpr.addTerms(C.data(), vars_.data(), nrvar_);
+	model_.setObjective(0.5*qexpr+lexpr);
+	++stats_.apiCalls;
+	stats_.coeffsChanged += qexpr.size() + nrvar_;
+
+	if (incrementalObj_)
+	{
+		Q_ = Q;
+		C_ = C;
+		objCached_ = true;
+	}
+}
+
+void GurobiDense::updateLinearObjective(const Ref<const VectorXd>& C)
+{
+	if (recorder_)
+	{
+		throw "objective updates cannot be recorded, use solve()";
+	}
+	sendLinearObjective(C);
+}
+
+void GurobiDense::sendLinearObjective(const Ref<const VectorXd>& C)
+{
+	assert(C.rows() == nrvar_);
+
+	ScopedTimer timer(collectStats_, stats_.objectiveTime);
+	if (!objCached_)
+	{
+		// The linear coefficients of the model are unknown, send all of them.
+		model_.set(GRB_DoubleAttr_Obj, vars_.data(), C.data(), nrvar_);
+		++stats_.apiCalls;
+		stats_.coeffsChanged += nrvar_;
+		if (incrementalObj_)
+		{
+			C_ = C;
+		}
+		return;
+	}
+
+	objVars_.clear();
+	objVals_.clear();
+	for(int i = 0; i < nrvar_; ++i)
+	{
+		if (C(i) != C_(i))
+		{
+			objVars_.push_back(vars_[i]);
+			objVals_.push_back(C(i));
+		}
+	}
+
+	if (!objVars_.empty())
+	{
+		model_.set(GRB_DoubleAttr_Obj, objVars_.data(), objVals_.data(),
+			static_cast<int>(objVars_.size()));
+		++stats_.apiCalls;
+		stats_.coeffsChanged += static_cast<long>(objVars_.size());
+		C_ = C;
+	}
+}
+
+void GurobiDense::updateBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU, bool cached)
+{
+	assert(XL.rows() == nrvar_);
+	assert(XU.rows() == nrvar_);
+
+	ScopedTimer timer(collectStats_, stats_.boundsTime);
+	updateChanged(GRB_DoubleAttr_LB, vars_.data(), XL_, XL, cached);
+	updateChanged(GRB_DoubleAttr_UB, vars_.data(), XU_, XU, cached);
+}
+
+void GurobiDense::updateConstr(GRBConstr* constrs, MatrixXd& Acache, VectorXd& bcache,
+	const Ref<const MatrixXd>& A, const Ref<const VectorXd>& b, int len, bool cached)
+{
+	assert(A.rows() == len);
+	assert(b.rows() == len);
+
+	ScopedTimer timer(collectStats_, stats_.constraintsTime);
+	if (len > 0 && (!cached || A != Acache))
+	{
+		for(int i = 0; i < nrvar_; ++i)
+		{
+			std::fill(colvars_.begin(), colvars_.begin()+len, vars_[i]);
+			model_.chgCoeffs(constrs, colvars_.data(), A.col(i).data(), static_cast<int>(A.rows()));
+		}
+		stats_.apiCalls += nrvar_;
+		stats_.coeffsChanged += static_cast<long>(nrvar_)*len;
+		Acache = A;
+	}
+
+	updateChanged(GRB_DoubleAttr_RHS, constrs, bcache, b, cached);
+}
+
+
+bool GurobiDense::solve(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+	                     const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+                         const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+                         const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	if (recorder_)
+	{
+		recorder_->record(*this, Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+	}
+
+	staged_ = 0;
+	sendObjective(Q, C);
+	updateData(Aeq, Beq, Aineq, Bineq, XL, XU);
+
+	return optimize();
+}
+
+
+GurobiCommon::SolveResult GurobiDense::trySolve(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+	const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+	const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU) noexcept
+{
+	return guardedSolve([&]() { solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU); });
+}
+
+
+bool GurobiDense::solve(const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+                         const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+                         const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	if (recorder_)
+	{
+		throw "solves without the objective cannot be recorded";
+	}
+	// The staged objective is still sent by optimize()
+	staged_ &= ~(STAGED_EQ | STAGED_INEQ | STAGED_BOUNDS);
+	updateData(Aeq, Beq, Aineq, Bineq, XL, XU);
+
+	return optimize();
+}
+
+
+bool GurobiDense::solve(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+	const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+	const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& BineqL,
+	const Ref<const VectorXd>& BineqU,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	assert(Aineq.rows() == nrineq_ && Aineq.cols() == nrvar_);
+	if (recorder_)
+	{
+		throw "range inequality solves cannot be recorded";
+	}
+
+	staged_ = 0;
+	sendObjective(Q, C);
+	const bool wasRanged = ranged_;
+	rangeInequalities(true);
+
+	// The singleton rows become bounds, and are sent without coefficients.
+	// Aineq_ holds the range rows of the last solve while the form is kept.
+	bool cached = dataCached_;
+	dataCached_ = false;
+	bool coeffsSent = false;
+	if (cached && wasRanged && singletonsCached_)
+	{
+		coeffsSent = updateRangeCoeffs(Aineq);
+	}
+	if (!coeffsSent)
+	{
+		findSingletons(Aineq);
+	}
+	boundSingletons(XL, XU, BineqL, BineqU);
+
+	updateBounds(singletonXL_, singletonXU_, cached);
+	updateConstr(eqconstr_.data(), Aeq_, Beq_, Aeq, Beq, nreq_, cached);
+	// The right hand sides of the range rows are the zeros of Bineq_, so
+	// nothing is left to send when the coefficients are already sent
+	if (!coeffsSent && singletons_.empty())
+	{
+		updateConstr(ineqconstr_.data(), Aineq_, Bineq_, Aineq, Bineq_, nrineq_, cached);
+	}
+	else if (!coeffsSent)
+	{
+		Arange_ = Aineq;
+		for(const Singleton& s : singletons_)
+		{
+			Arange_.row(s.row).setZero();
+		}
+		updateConstr(ineqconstr_.data(), Aineq_, Bineq_, Arange_, Bineq_, nrineq_, cached);
+	}
+	updateRanges(singletonL_, singletonU_);
+	dataCached_ = true;
+	singletonsCached_ = true;
+
+	return optimize();
+}
+
+
+void GurobiDense::findSingletons(const Ref<const MatrixXd>& Aineq)
+{
+	singletons_.clear();
+	singletonRow_.setConstant(nrineq_, -1);
+	for(int i = 0; i < nrineq_; ++i)
+	{
+		int nnz = 0;
+		int var = 0;
+		for(int j = 0; j < nrvar_ && nnz < 2; ++j)
+		{
+			if (Aineq(i, j) != 0.)
+			{
+				++nnz;
+				var = j;
+			}
+		}
+		if (nnz == 1)
+		{
+			singletonRow_(i) = static_cast<int>(singletons_.size());
+			singletons_.push_back({i, var, Aineq(i, var), false, false});
+		}
+	}
+}
+
+
+bool GurobiDense::updateRangeCoeffs(const Ref<const MatrixXd>& Aineq)
+{
+	assert(singletonRow_.rows() == nrineq_);
+
+	// A row keeps its number of nonzeros if its zeros are unchanged, the
+	// singleton rows if their nonzero stays on their variable
+	for(int j = 0; j < nrvar_; ++j)
+	{
+		for(int i = 0; i < nrineq_; ++i)
+		{
+			const int k = singletonRow_(i);
+			const bool nonzero = Aineq(i, j) != 0.;
+			if (k >= 0 ? nonzero != (j == singletons_[static_cast<size_t>(k)].var)
+				: nonzero != (Aineq_(i, j) != 0.))
+			{
+				return false;
+			}
+		}
+	}
+
+	ScopedTimer timer(collectStats_, stats_.constraintsTime);
+	for(Singleton& s : singletons_)
+	{
+		s.coeff = Aineq(s.row, s.var);
+	}
+	for(int j = 0; j < nrvar_; ++j)
+	{
+		bool changed = false;
+		for(int i = 0; i < nrineq_; ++i)
+		{
+			if (singletonRow_(i) < 0 && Aineq(i, j) != Aineq_(i, j))
+			{
+				Aineq_(i, j) = Aineq(i, j);
+				changed = true;
+			}
+		}
+		if (changed)
+		{
+			std::fill(colvars_.begin(), colvars_.begin()+nrineq_, vars_[j]);
+			model_.chgCoeffs(ineqconstr_.data(), colvars_.data(), Aineq_.col(j).data(), nrineq_);
+			++stats_.apiCalls;
+			stats_.coeffsChanged += nrineq_;
+		}
+	}
+	return true;
+}
+
+
+std::vector<int> GurobiDense::solveParametric(const Ref<const MatrixXd>& Q, const Ref<const MatrixXd>& Cs,
+	const Ref<const MatrixXd>& Aeq, const Ref<const MatrixXd>& Beqs,
+	const Ref<const MatrixXd>& Aineq, const Ref<const MatrixXd>& Bineqs,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU, Ref<MatrixXd> X)
+{
+	const Index nrInst = parametricSize(Cs, Beqs, Bineqs);
+	assert(X.rows() == nrvar_ && X.cols() == nrInst);
+
+	std::vector<int> status(static_cast<size_t>(nrInst));
+	for(Index k = 0; k < nrInst; ++k)
+	{
+		if (k == 0)
+		{
+			solve(Q, Cs.col(0), Aeq, Beqs.col(0), Aineq, Bineqs.col(0), XL, XU);
+		}
+		else
+		{
+			if (recorder_)
+			{
+				recorder_->record(*this, Q, Cs.col(instanceCol(Cs, k)), Aeq, Beqs.col(instanceCol(Beqs, k)),
+					Aineq, Bineqs.col(instanceCol(Bineqs, k)), XL, XU);
+			}
+			// The matrices are already in the model
+			sendLinearObjective(Cs.col(instanceCol(Cs, k)));
+			{
+				ScopedTimer timer(collectStats_, stats_.constraintsTime);
+				updateChanged(GRB_DoubleAttr_RHS, eqconstr_.data(), Beq_, Beqs.col(instanceCol(Beqs, k)), true);
+				updateChanged(GRB_DoubleAttr_RHS, ineqconstr_.data(), Bineq_, Bineqs.col(instanceCol(Bineqs, k)), true);
+			}
+			optimize();
+		}
+		storeInstance(k, X, status);
+	}
+	return status;
+}
+
+GurobiCommon::AsyncSolve GurobiDense::solveAsync(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+	const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+	const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	if (recorder_)
+	{
+		recorder_->record(*this, Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+	}
+
+	staged_ = 0;
+	sendObjective(Q, C);
+	updateData(Aeq, Beq, Aineq, Bineq, XL, XU);
+
+	return optimizeAsync();
+}
+
+
+void GurobiDense::updateData(const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+	const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	rangeInequalities(false);
+
+	// Only the data that differ from the last solve are sent to Gurobi.
+	// The cache is invalid until all the updates succeeded.
+	bool cached = dataCached_;
+	dataCached_ = false;
+
+	updateBounds(XL, XU, cached);
+
+	//Update eq and ineq, column by column
+	updateConstr(eqconstr_.data(), Aeq_, Beq_, Aeq, Beq, nreq_, cached);
+	updateConstr(ineqconstr_.data(), Aineq_, Bineq_, Aineq, Bineq, nrineq_, cached);
+
+	dataCached_ = true;
+}
+
+
+GurobiCommon::MemoryUsage GurobiDense::memoryUsage() const
+{
+	MemoryUsage usage = GurobiCommon::memoryUsage();
+	usage.wrapper += bytes(Aeq_) + bytes(Aineq_)
+		+ bytes(stagedQ_) + bytes(stagedAeq_) + bytes(stagedAineq_) + bytes(stagedC_)
+		+ bytes(stagedBeq_) + bytes(stagedBineq_) + bytes(stagedXL_) + bytes(stagedXU_);
+	usage.wrapper += bytes(singletonRow_);
+	usage.scratch += bytes(Arange_) + bytes(objVars_) + bytes(objVals_);
+	return usage;
+}
+
+void GurobiDense::compact()
+{
+	GurobiCommon::compact();
+	Arange_.resize(0, 0);
+	release(objVars_);
+	release(objVals_);
+	if (staged_ == 0)
+	{
+		stagedQ_.resize(0, 0);
+		stagedAeq_.resize(0, 0);
+		stagedAineq_.resize(0, 0);
+		stagedC_.resize(0);
+		stagedBeq_.resize(0);
+		stagedBineq_.resize(0);
+		stagedXL_.resize(0);
+		stagedXU_.resize(0);
+	}
+}
+
+void GurobiDense::beginUpdate()
+{
+	staged_ = 0;
+}
+
+void GurobiDense::setQ(const Ref<const MatrixXd>& Q)
+{
+	assert(Q.rows() == nrvar_ && Q.cols() == nrvar_);
+	stagedQ_ = Q;
+	staged_ |= STAGED_Q;
+}
+
+void GurobiDense::setC(const Ref<const VectorXd>& C)
+{
+	assert(C.rows() == nrvar_);
+	stagedC_ = C;
+	staged_ |= STAGED_C;
+}
+
+void GurobiDense::setAeq(const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq)
+{
+	assert(Aeq.rows() == nreq_ && Aeq.cols() == nrvar_ && Beq.rows() == nreq_);
+	stagedAeq_ = Aeq;
+	stagedBeq_ = Beq;
+	staged_ |= STAGED_EQ;
+}
+
+void GurobiDense::setAineq(const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq)
+{
+	assert(Aineq.rows() == nrineq_ && Aineq.cols() == nrvar_ && Bineq.rows() == nrineq_);
+	stagedAineq_ = Aineq;
+	stagedBineq_ = Bineq;
+	staged_ |= STAGED_INEQ;
+}
+
+void GurobiDense::setBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	assert(XL.rows() == nrvar_ && XU.rows() == nrvar_);
+	stagedXL_ = XL;
+	stagedXU_ = XU;
+	staged_ |= STAGED_BOUNDS;
+}
+
+bool GurobiDense::updatePending() const
+{
+	return staged_ != 0;
+}
+
+void GurobiDense::commit()
+{
+	commitStaged();
+	GurobiCommon::commit();
+}
+
+void GurobiDense::commitStaged()
+{
+	if (staged_ != 0 && recorder_)
+	{
+		throw "staged updates cannot be recorded, use solve()";
+	}
+
+	if (staged_ & STAGED_Q)
+	{
+		assert((staged_ & STAGED_C) || objCached_);
+		sendObjective(stagedQ_, (staged_ & STAGED_C) ? stagedC_ : C_);
+	}
+	else if (staged_ & STAGED_C)
+	{
+		sendLinearObjective(stagedC_);
+	}
+
+	const int constraints = STAGED_EQ | STAGED_INEQ | STAGED_BOUNDS;
+	if (staged_ & constraints)
+	{
+		// The caches hold the data that are not staged
+		assert(dataCached_ || (staged_ & constraints) == constraints);
+		// The caches of a problem with ranges do not hold plain inequalities
+		assert(!ranged_ || (staged_ & (STAGED_INEQ | STAGED_BOUNDS)) == (STAGED_INEQ | STAGED_BOUNDS));
+		const bool eq = (staged_ & STAGED_EQ) != 0;
+		const bool ineq = (staged_ & STAGED_INEQ) != 0;
+		const bool bounds = (staged_ & STAGED_BOUNDS) != 0;
+		updateData(eq ? stagedAeq_ : Aeq_, eq ? stagedBeq_ : Beq_,
+			ineq ? stagedAineq_ : Aineq_, ineq ? stagedBineq_ : Bineq_,
+			bounds ? stagedXL_ : XL_, bounds ? stagedXU_ : XU_);
+	}
+	staged_ = 0;
+}
+
+
+/**
+ * GurobiSparse
+ */
+
+
+GurobiSparse::GurobiSparse():
+	objCached_(false),
+	boundsCached_(false)
+{
+	resetPattern(eqpattern_);
+	resetPattern(ineqpattern_);
+	resetPattern(respattern_);
+}
+
+
+GurobiSparse::GurobiSparse(int nrvar, int nreq, int nrineq):
+	objCached_(false),
+	boundsCached_(false)
+{
+  problem(nrvar, nreq, nrineq);
+}
+
+
+GurobiSparse::GurobiSparse(std::shared_ptr<GRBEnv> env):
+	GurobiCommon(std::move(env)),
+	objCached_(false),
+	boundsCached_(false)
+{
+	resetPattern(eqpattern_);
+	resetPattern(ineqpattern_);
+	resetPattern(respattern_);
+}
+
+
+GurobiSparse::GurobiSparse(std::shared_ptr<GRBEnv> env, int nrvar, int nreq, int nrineq):
+	GurobiCommon(std::move(env)),
+	objCached_(false),
+	boundsCached_(false)
+{
+	problem(nrvar, nreq, nrineq);
+}
+
+
+GurobiSparse::GurobiSparse(const std::string& path):
+	GurobiSparse(std::make_shared<GRBEnv>(), path)
+{
+}
+
+
+GurobiSparse::GurobiSparse(std::shared_ptr<GRBEnv> env, const std::string& path):
+	GurobiCommon(std::move(env), path),
+	objCached_(false),
+	boundsCached_(false)
+{
+	resetPattern(eqpattern_);
+	resetPattern(ineqpattern_);
+	resetPattern(respattern_);
+	loadPattern(eqconstr_, eqpattern_, Beq_);
+	loadPattern(ineqconstr_, ineqpattern_, Bineq_);
+
+	XL_.resize(nrvar_);
+	XU_.resize(nrvar_);
+	getAttr(GRB_DoubleAttr_LB, vars_.data(), nrvar_, XL_.data());
+	getAttr(GRB_DoubleAttr_UB, vars_.data(), nrvar_, XU_.data());
+	boundsCached_ = true;
+	resizeRhs();
+}
+
+
+void GurobiSparse::problem(int nrvar, int nreq, int nrineq)
+{
+	leastSquares(0);
+	GurobiCommon::problem(nrvar, nreq, nrineq);
+
+	objCached_ = false;
+	boundsCached_ = false;
+	resetPattern(eqpattern_);
+	resetPattern(ineqpattern_);
+	resetPattern(respattern_);
+	resizeRhs();
+}
+
+void GurobiSparse::resizeRhs()
+{
+	rhsEq_.setZero(nreq_);
+	rhsIneq_.setZero(nrineq_);
+}
+
+void GurobiSparse::addVariables(int nrvar)
+{
+	GurobiCommon::addVariables(nrvar);
+
+	objCached_ = false;
+	remapPattern(eqpattern_, {}, {}, nrvar_);
+	remapPattern(ineqpattern_, {}, {}, nrvar_);
+	remapPattern(respattern_, {}, {}, nrvar_);
+}
+
+void GurobiSparse::removeVariables(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	const int nrvar = indexMap(nrvar_, indices, map);
+	remapPattern(eqpattern_, {}, map, nrvar);
+	remapPattern(ineqpattern_, {}, map, nrvar);
+	remapPattern(respattern_, {}, map, nrvar);
+
+	objCached_ = false;
+	GurobiCommon::removeVariables(indices);
+}
+
+void GurobiSparse::addEqualities(int nreq)
+{
+	// The new rows have no coefficients: the pattern is unchanged
+	GurobiCommon::addEqualities(nreq);
+	resizeRhs();
+}
+
+void GurobiSparse::removeEqualities(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	indexMap(nreq_, indices, map);
+	remapPattern(eqpattern_, map, {}, nrvar_);
+
+	GurobiCommon::removeEqualities(indices);
+	resizeRhs();
+}
+
+void GurobiSparse::addInequalities(int nrineq)
+{
+	GurobiCommon::addInequalities(nrineq);
+	resizeRhs();
+}
+
+void GurobiSparse::removeInequalities(const std::vector<int>& indices)
+{
+	std::vector<int> map;
+	indexMap(nrineq_, indices, map);
+	remapPattern(ineqpattern_, map, {}, nrvar_);
+
+	GurobiCommon::removeInequalities(indices);
+	resizeRhs();
+}
+
+void GurobiSparse::remapPattern(CoeffPattern& pattern, const std::vector<int>& rowMap,
+	const std::vector<int>& colMap, int nrcol)
+{
+	// An invalid pattern is rebuilt from scratch by the next solve
+	if(!pattern.valid)
+	{
+		return;
+	}
+
+	std::vector<int> outer(1, 0);
+	outer.reserve(static_cast<size_t>(nrcol+1));
+	size_t w = 0;
+	const int oldNrcol = static_cast<int>(pattern.outer.size()) - 1;
+	for(int k = 0; k < oldNrcol; ++k)
+	{
+		if(!colMap.empty() && colMap[static_cast<size_t>(k)] < 0)
+		{
+			continue;
+		}
+		for(int p = pattern.outer[static_cast<size_t>(k)]; p < pattern.outer[static_cast<size_t>(k+1)]; ++p)
+		{
+			const size_t sp = static_cast<size_t>(p);
+			const int row = rowMap.empty() ? pattern.inner[sp] :
+				rowMap[static_cast<size_t>(pattern.inner[sp])];
+			if(row >= 0)
+			{
+				pattern.inner[w] = row;
+				pattern.constrs[w] = pattern.constrs[sp];
+				pattern.vars[w] = pattern.vars[sp];
+				++w;
+			}
+		}
+		outer.push_back(static_cast<int>(w));
+	}
+	outer.resize(static_cast<size_t>(nrcol+1), static_cast<int>(w));
+
+	pattern.outer.swap(outer);
+	pattern.inner.resize(w);
+	pattern.constrs.resize(w);
+	pattern.vars.resize(w);
+}
+
+void GurobiSparse::loadPattern(const std::vector<GRBConstr>& constrs,
+	CoeffPattern& pattern, VectorXd& bcache)
+{
+	// (column, row) of every coefficient
+	std::vector<std::pair<int, int>> entries;
+	const int len = static_cast<int>(constrs.size());
+	for(int r = 0; r < len; ++r)
+	{
+		GRBLinExpr row = model_.getRow(constrs[static_cast<size_t>(r)]);
+		for(unsigned int k = 0; k < row.size(); ++k)
+		{
+			entries.emplace_back(row.getVar(static_cast<int>(k)).index(), r);
+		}
+	}
+
+	// The model is updated: the indices of the variables follow vars_
+	std::vector<int> colIndex(static_cast<size_t>(nrvar_));
+	for(int k = 0; k < nrvar_; ++k)
+	{
+		colIndex[static_cast<size_t>(vars_[k].index())] = k;
+	}
+	for(std::pair<int, int>& e: entries)
+	{
+		e.first = colIndex[static_cast<size_t>(e.first)];
+	}
+	// Column-major order
+	std::sort(entries.begin(), entries.end());
+
+	pattern.outer.assign(static_cast<size_t>(nrvar_+1), 0);
+	pattern.inner.resize(entries.size());
+	pattern.constrs.resize(entries.size());
+	pattern.vars.resize(entries.size());
+	for(size_t p = 0; p < entries.size(); ++p)
+	{
+		++pattern.outer[static_cast<size_t>(entries[p].first+1)];
+		pattern.inner[p] = entries[p].second;
+		pattern.constrs[p] = constrs[static_cast<size_t>(entries[p].second)];
+		pattern.vars[p] = vars_[entries[p].first];
+	}
+	std::partial_sum(pattern.outer.begin(), pattern.outer.end(), pattern.outer.begin());
+	pattern.valid = true;
+
+	bcache.resize(len);
+	getAttr(GRB_DoubleAttr_RHS, constrs.data(), len, bcache.data());
+	pattern.rhsValid = true;
+}
+
+void GurobiSparse::updateConstr(GRBConstr* constrs, CoeffPattern& pattern, VectorXd& bcache,
+			VectorXd& rhs, const Eigen::SparseMatrix<double>& A,
+			const Eigen::SparseVector<double>& b, int len)
 {
-	std::cout << statusDescription() << std::endl;
+	assert(b.size() == len);
+
+	updateCoeffs(constrs, pattern, A, len);
+
+	if(len > 0)
+	{
+		ScopedTimer timer(collectStats_, stats_.constraintsTime);
+
+		//Update RHSes: the entries missing from b are zeros,
+		//rhs is only allocated again after compact()
+		rhs.setZero(len);
+		for(SparseVector<double>::InnerIterator it(b); it; ++it)
+		{
+			rhs(it.index()) = it.value();
+		}
+		updateChanged(GRB_DoubleAttr_RHS, constrs, bcache, rhs, pattern.rhsValid);
+		pattern.rhsValid = true;
+	}
 }
 
-void GurobiCommon::displayOutput(bool doDisplay)
+GurobiCommon::AsyncSolve GurobiSparse::solveAsync(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
 {
-	model_.set(GRB_IntParam_OutputFlag, doDisplay);
+	if (recorder_)
+	{
+		recorder_->record(*this, Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+	}
+
+	updateModel(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+
+	return optimizeAsync();
 }
 
-double GurobiCommon::feasibilityTolerance() const
+
+void GurobiSparse::loadProblem(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
 {
-	return model_.get(GRB_DoubleParam_FeasibilityTol);
+	if (recorder_)
+	{
+		throw "loaded problems cannot be recorded, use solve()";
+	}
+
+	problem(static_cast<int>(XL.rows()), static_cast<int>(Aeq.rows()), static_cast<int>(Aineq.rows()));
+	updateModel(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
 }
 
-void GurobiCommon::feasibilityTolerance(double tol)
+
+void GurobiSparse::loadProblem(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double, RowMajor>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double, RowMajor>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
 {
-	assert(1e-2 >= tol && tol >= 1e-9);
-	model_.set(GRB_DoubleParam_FeasibilityTol, tol);
+	// The coefficients are updated column by column, which needs the CSC pattern
+	SparseMatrix<double> cscAeq(Aeq);
+	SparseMatrix<double> cscAineq(Aineq);
+	loadProblem(Q, C, cscAeq, Beq, cscAineq, Bineq, XL, XU);
 }
 
-double GurobiCommon::optimalityTolerance() const
+
+bool GurobiSparse::solve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
 {
-	return model_.get(GRB_DoubleParam_OptimalityTol);
+	if (recorder_)
+	{
+		recorder_->record(*this, Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+	}
+
+	updateModel(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+
+	return optimize();
 }
 
-void GurobiCommon::optimalityTolerance(double tol)
+
+GurobiCommon::SolveResult GurobiSparse::trySolve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU) noexcept
 {
-	assert(1e-2 >= tol && tol >= 1e-9);
-	model_.set(GRB_DoubleParam_OptimalityTol, tol);
+	return guardedSolve([&]() { solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU); });
 }
 
-void GurobiCommon::problem(int nrvar, int nreq, int nrineq)
+
+bool GurobiSparse::solve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const Ref<const VectorXd>& BineqL,
+	const Ref<const VectorXd>& BineqU,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
 {
-	for(int i = 0; i < nrvar_; ++i)
+	assert(Aineq.rows() == nrineq_ && Aineq.cols() == nrvar_);
+	if (recorder_)
 	{
-		model_.remove(*(vars_+i));
+		throw "range inequality solves cannot be recorded";
 	}
 
-	for(int i = 0; i < nreq_; ++i)
+	leastSquares(0);
+	updateObjective(Q, C);
+	rangeInequalities(true);
+
+	// The singleton rows become bounds, and are sent without coefficients
+	std::vector<int> rowNnz(static_cast<size_t>(nrineq_), 0);
+	for(int k = 0; k < Aineq.outerSize(); ++k)
 	{
-		model_.remove(*(eqconstr_+i));
+		for(SparseMatrix<double>::InnerIterator it(Aineq, k); it; ++it)
+		{
+			++rowNnz[static_cast<size_t>(it.row())];
+		}
 	}
-
-	for(int i = 0; i < nrineq_; ++i)
+	singletons_.clear();
+	for(int k = 0; k < Aineq.outerSize(); ++k)
 	{
-		model_.remove(*(ineqconstr_+i));
+		for(SparseMatrix<double>::InnerIterator it(Aineq, k); it; ++it)
+		{
+			if (rowNnz[static_cast<size_t>(it.row())] == 1)
+			{
+				singletons_.push_back({static_cast<int>(it.row()), static_cast<int>(it.col()),
+					it.value(), false, false});
+			}
+		}
 	}
+	boundSingletons(XL, XU, BineqL, BineqU);
 
-	eqvars_.clear();
-	ineqvars_.clear();
-	lvars_.clear();
-	rvars_.clear();
-
-	nrvar_ = nrvar;
-	nreq_ = nreq;
-	nrineq_ = nrineq;
-
-	Q_.resize(nrvar, nrvar);
+	updateBounds(singletonXL_, singletonXU_);
+	updateConstr(eqconstr_.data(), eqpattern_, Beq_, rhsEq_, Aeq, Beq, nreq_);
+	// The right hand sides of the range rows stay null
+	if (singletons_.empty())
+	{
+		updateCoeffs(ineqconstr_.data(), ineqpattern_, Aineq, nrineq_);
+	}
+	else
+	{
+		Arange_ = Aineq;
+		Arange_.prune([&rowNnz](Index row, Index, double) { return rowNnz[static_cast<size_t>(row)] != 1; });
+		updateCoeffs(ineqconstr_.data(), ineqpattern_, Arange_, nrineq_);
+	}
+	updateRanges(singletonL_, singletonU_);
 
-	C_.resize(nrvar);
-	Beq_.resize(nreq);
-	Bineq_.resize(nrineq);
-	X_.resize(nrvar);
-	Yeq_.resize(nreq);
-	Yineq_.resize(nrineq);
+	return optimize();
+}
 
-	vars_ = model_.addVars(nrvar, GRB_CONTINUOUS);
 
-	for(int i=0; i < Q_.size(); ++i)
+bool GurobiSparse::solveLeastSquares(const SparseMatrix<double>& J, const Ref<const VectorXd>& r,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	const int nrres = static_cast<int>(J.rows());
+	assert(J.cols() == XL.rows());
+	assert(r.rows() == nrres);
+	assert(Aeq.cols() == XL.rows() && Aineq.cols() == XL.rows());
+	if (recorder_)
 	{
-		lvars_.push_back(*(vars_+i/nrvar));
-		rvars_.push_back(*(vars_+i%nrvar));
+		throw "least squares solves cannot be recorded";
 	}
 
-	eqconstr_ = model_.addConstrs(nreq);
-	std::vector<char> eqsense(static_cast<size_t>(nreq), '=');
-	model_.set(GRB_CharAttr_Sense, eqconstr_, eqsense.data(), nreq);
-
-	eqvars_.reserve(static_cast<size_t>(nrvar*nreq));
-	for(int i = 0; i < nrvar; ++i)
+	if (nrvar_ != XL.rows() || nreq_ != Aeq.rows() || nrineq_ != Aineq.rows())
 	{
-		eqvars_.insert(eqvars_.end(), static_cast<size_t>(nreq), *(vars_+i));
+		problem(static_cast<int>(XL.rows()), static_cast<int>(Aeq.rows()), static_cast<int>(Aineq.rows()));
 	}
 
-	ineqconstr_ = model_.addConstrs(nrineq);
-	std::vector<char> ineqsense(static_cast<size_t>(nrineq), '<');
-	model_.set(GRB_CharAttr_Sense, ineqconstr_, ineqsense.data(), nrineq);
+	rangeInequalities(false);
+	leastSquares(nrres);
+	updateBounds(XL, XU);
+	updateConstr(eqconstr_.data(), eqpattern_, Beq_, rhsEq_, Aeq, Beq, nreq_);
+	updateConstr(ineqconstr_.data(), ineqpattern_, Bineq_, rhsIneq_, Aineq, Bineq, nrineq_);
 
-	for(int i = 0; i < nrvar; ++i)
+	// J x - y = r, the coefficients of y are set once by leastSquares()
+	if (colvars_.size() < static_cast<size_t>(nrres))
 	{
-		ineqvars_.insert(ineqvars_.end(), static_cast<size_t>(nrineq_), *(vars_+i));
+		colvars_.resize(static_cast<size_t>(nrres));
+	}
+	updateCoeffs(resconstr_.data(), respattern_, J, nrres);
+	if (nrres > 0)
+	{
+		ScopedTimer timer(collectStats_, stats_.constraintsTime);
+		updateChanged(GRB_DoubleAttr_RHS, resconstr_.data(), resRhs_, r, respattern_.rhsValid);
+		respattern_.rhsValid = true;
 	}
-}
 
-void GurobiCommon::setVariableType(int varIndex, char GRBType) {
-    model_.getVar(varIndex).set(GRB_CharAttr_VType, GRBType);
+	const bool solved = optimize();
+	if (solved)
+	{
+		// The statistics were moved by optimize()
+		lastStats_.apiCalls += getAttr(GRB_DoubleAttr_X, resvars_.data(), nrres, residuals_.data());
+	}
+	// The basis of vars_ and the constraints does not cover the residuals
+	hasBasis_ = false;
+	return solved;
 }
 
 
-/**
- * GurobiDense
- */
-
-
-GurobiDense::GurobiDense()
-{ }
+void GurobiSparse::leastSquares(int nrres)
+{
+	if (nrres == static_cast<int>(resvars_.size()))
+	{
+		return;
+	}
 
+	ScopedTimer timer(collectStats_, stats_.constraintsTime);
+	for(GRBVar& y : resvars_)
+	{
+		model_.remove(y);
+	}
+	for(GRBConstr& c : resconstr_)
+	{
+		model_.remove(c);
+	}
+	resvars_.clear();
+	resconstr_.clear();
+	resetPattern(respattern_);
+	residuals_.setZero(nrres);
 
-GurobiDense::GurobiDense(int nrvar, int nreq, int nrineq)
-{
-	problem(nrvar, nreq, nrineq);
+	if (nrres > 0)
+	{
+		// Free residuals, with -y in their equalities and the objective 1/2 y^T y
+		std::vector<double> lb(static_cast<size_t>(nrres), -GRB_INFINITY);
+		std::vector<double> ub(static_cast<size_t>(nrres), GRB_INFINITY);
+		GRBVar* vars = model_.addVars(lb.data(), ub.data(), nullptr, nullptr, nullptr, nrres);
+		resvars_.assign(vars, vars + nrres);
+		delete[] vars;
+
+		int len = 0;
+		appendConstrs(resconstr_, len, nrres, '=');
+		std::vector<double> coeffs(static_cast<size_t>(nrres), -1.);
+		model_.chgCoeffs(resconstr_.data(), resvars_.data(), coeffs.data(), nrres);
+
+		GRBQuadExpr qexpr;
+		for(const GRBVar& y : resvars_)
+		{
+			qexpr.addTerm(0.5, y, y);
+		}
+		model_.setObjective(qexpr);
+		stats_.apiCalls += 3;
+		stats_.coeffsChanged += nrres + qexpr.size();
+	}
+	// The objective of x is no longer in the model
+	objCached_ = false;
+	// The basis of the other form does not apply
+	hasBasis_ = false;
 }
 
 
-void GurobiDense::problem(int nrvar, int nreq, int nrineq)
+std::vector<int> GurobiSparse::solveParametric(const SparseMatrix<double>& Q, const Ref<const MatrixXd>& Cs,
+	const SparseMatrix<double>& Aeq, const Ref<const MatrixXd>& Beqs,
+	const SparseMatrix<double>& Aineq, const Ref<const MatrixXd>& Bineqs,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU, Ref<MatrixXd> X)
 {
-	GurobiCommon::problem(nrvar, nreq, nrineq);
+	const Index nrInst = parametricSize(Cs, Beqs, Bineqs);
+	assert(X.rows() == nrvar_ && X.cols() == nrInst);
+
+	std::vector<int> status(static_cast<size_t>(nrInst));
+	for(Index k = 0; k < nrInst; ++k)
+	{
+		if (k == 0)
+		{
+			SparseVector<double> C(Cs.col(0).sparseView());
+			SparseVector<double> Beq(Beqs.col(0).sparseView());
+			SparseVector<double> Bineq(Bineqs.col(0).sparseView());
+			solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+			C_ = Cs.col(0);
+		}
+		else
+		{
+			if (recorder_)
+			{
+				SparseVector<double> C(Cs.col(instanceCol(Cs, k)).sparseView());
+				SparseVector<double> Beq(Beqs.col(instanceCol(Beqs, k)).sparseView());
+				SparseVector<double> Bineq(Bineqs.col(instanceCol(Bineqs, k)).sparseView());
+				recorder_->record(*this, Q, C, Aeq, Beq, Aineq, Bineq, XL, XU);
+			}
+			// The matrices are already in the model
+			{
+				ScopedTimer timer(collectStats_, stats_.objectiveTime);
+				updateChanged(GRB_DoubleAttr_Obj, vars_.data(), C_, Cs.col(instanceCol(Cs, k)), true);
+			}
+			{
+				ScopedTimer timer(collectStats_, stats_.constraintsTime);
+				updateChanged(GRB_DoubleAttr_RHS, eqconstr_.data(), Beq_, Beqs.col(instanceCol(Beqs, k)), true);
+				updateChanged(GRB_DoubleAttr_RHS, ineqconstr_.data(), Bineq_, Bineqs.col(instanceCol(Bineqs, k)), true);
+			}
+			optimize();
+		}
+		storeInstance(k, X, status);
+	}
+	return status;
 }
 
-void GurobiDense::updateConstr(GRBConstr* constrs, const std::vector<GRBVar>& vars,
-	const Eigen::MatrixXd& A, const Eigen::VectorXd& b, int len)
+void GurobiSparse::updateObjective(const SparseMatrix<double>& Q, const SparseVector<double>& C)
 {
-	assert(A.rows() == len);
-	assert(b.rows() == len);
+	assert(Q.rows() == nrvar_ && Q.cols() == nrvar_);
+	assert(C.size() == nrvar_);
 
-	if (len > 0)
+	ScopedTimer timer(collectStats_, stats_.objectiveTime);
+	linObj_.setZero(nrvar_);
+	for (SparseVector<double>::InnerIterator it(C); it; ++it)
 	{
-		for(int i = 0; i < nrvar_; ++i)
+		linObj_(it.index()) = it.value();
+	}
+
+	if (objCached_ && sameSparse(Q, Qcache_))
+	{
+		// Only the linear coefficients that changed
+		updateChanged(GRB_DoubleAttr_Obj, vars_.data(), C_, linObj_, true);
+		return;
+	}
+
+	//Objective: quadratic terms
+	GRBQuadExpr qexpr;
+	for(int k = 0; k<Q.outerSize(); ++k)
+	{
+		for (SparseMatrix<double>::InnerIterator it(Q,k); it; ++it)
 		{
-			model_.chgCoeffs(constrs, vars.data()+len*i, A.col(i).data(), static_cast<int>(A.rows()));
+			qexpr.addTerm(0.5*it.value(), vars_[it.row()], vars_[it.col()]);
 		}
 	}
 
-	model_.set(GRB_DoubleAttr_RHS, constrs, b.data(), len);
+	//Objective: linear terms
+	for (SparseVector<double>::InnerIterator it(C); it; ++it)
+	{
+		qexpr.addTerm(it.value(), vars_[it.row()]);
+	}
+
+	model_.setObjective(qexpr);
+	++stats_.apiCalls;
+	stats_.coeffsChanged += qexpr.size();
+
+	Qcache_ = Q;
+	Qcache_.makeCompressed();
+	C_ = linObj_;
+	objCached_ = true;
 }
 
 
-bool GurobiDense::solve(const MatrixXd& Q, const VectorXd& C,
-	                     const MatrixXd& Aeq, const VectorXd& Beq,
-                         const MatrixXd& Aineq, const VectorXd& Bineq,
-                         const VectorXd& XL, const VectorXd& XU)
+const VectorXd& GurobiSparse::residuals() const
 {
-	//Objective
-	GRBQuadExpr qexpr;
-	qexpr.addTerms(Q.data(), rvars_.data(), lvars_.data(), static_cast<int>(Q.size()));
+	return residuals_;
+}
 
-	GRBLinExpr lexpr;
-	lexpr.addTerms(C.data(), vars_, nrvar_);
-	model_.setObjective(0.5*qexpr+lexpr);
 
-	model_.set(GRB_DoubleAttr_LB, vars_, XL.data(), nrvar_);
-	model_.set(GRB_DoubleAttr_UB, vars_, XU.data(), nrvar_);
+GurobiCommon::MemoryUsage GurobiSparse::memoryUsage() const
+{
+	MemoryUsage usage = GurobiCommon::memoryUsage();
+	for(const CoeffPattern* pattern : {&eqpattern_, &ineqpattern_})
+	{
+		usage.wrapper += bytes(pattern->outer) + bytes(pattern->inner)
+			+ bytes(pattern->constrs) + bytes(pattern->vars);
+	}
+	usage.wrapper += bytes(Qcache_) + bytes(resvars_) + bytes(resconstr_) + bytes(respattern_.outer)
+		+ bytes(respattern_.inner) + bytes(respattern_.constrs) + bytes(respattern_.vars)
+		+ bytes(resRhs_) + bytes(residuals_);
+	usage.scratch += bytes(rhsEq_) + bytes(rhsIneq_) + bytes(linObj_) + bytes(Arange_);
+	return usage;
+}
 
-	//Update eq and ineq, column by column
-	updateConstr(eqconstr_, eqvars_, Aeq, Beq, nreq_);
-	updateConstr(ineqconstr_, ineqvars_, Aineq, Bineq, nrineq_);
+void GurobiSparse::compact()
+{
+	GurobiCommon::compact();
+	rhsEq_.resize(0);
+	rhsIneq_.resize(0);
+	linObj_.resize(0);
+	Arange_ = SparseMatrix<double>();
+}
 
-	model_.optimize();
+void GurobiSparse::updateBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	//Bounds, only the changed ones
+	ScopedTimer timer(collectStats_, stats_.boundsTime);
+	assert(XL.rows() == nrvar_ && XU.rows() == nrvar_);
+	updateChanged(GRB_DoubleAttr_LB, vars_.data(), XL_, XL, boundsCached_);
+	updateChanged(GRB_DoubleAttr_UB, vars_.data(), XU_, XU, boundsCached_);
+	boundsCached_ = true;
+}
 
-	status_ = model_.get(GRB_IntAttr_Status);
-	iter_ = model_.get(GRB_IntAttr_BarIterCount);
-	if (success()) {
-		double* result = model_.get(GRB_DoubleAttr_X, vars_, nrvar_);
-		X_ = Map<VectorXd>(result, nrvar_);
-		double* dual_eq = model_.get(GRB_DoubleAttr_Pi, eqconstr_, nreq_);
-		Yeq_ = Map<VectorXd>(dual_eq, nreq_);
-		double* dual_ineq = model_.get(GRB_DoubleAttr_Pi, ineqconstr_, nrineq_);
-		Yineq_ = Map<VectorXd>(dual_ineq, nrineq_);
-	}
+void GurobiSparse::updateModel(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	rangeInequalities(false);
+	leastSquares(0);
+	updateObjective(Q, C);
+	updateBounds(XL, XU);
 
-	return success();
+	//Update eq
+	updateConstr(eqconstr_.data(), eqpattern_, Beq_, rhsEq_, Aeq, Beq, nreq_);
+	updateConstr(ineqconstr_.data(), ineqpattern_, Bineq_, rhsIneq_, Aineq, Bineq, nrineq_);
 }
 
 
 /**
- * GurobiSparse
+ * GurobiHybrid
  */
 
 
-GurobiSparse::GurobiSparse()
+GurobiHybrid::GurobiHybrid():
+	GurobiHybrid(std::make_shared<GRBEnv>())
 { }
 
 
-GurobiSparse::GurobiSparse(int nrvar, int nreq, int nrineq)
+GurobiHybrid::GurobiHybrid(int nrvar, int nreq, int nrineq):
+	GurobiHybrid()
 {
-  problem(nrvar, nreq, nrineq);
+	problem(nrvar, nreq, nrineq);
 }
 
 
-void GurobiSparse::problem(int nrvar, int nreq, int nrineq)
+GurobiHybrid::GurobiHybrid(std::shared_ptr<GRBEnv> env):
+	GurobiCommon(std::move(env)),
+	objCached_(false),
+	boundsCached_(false)
+{
+	resetBlock(eqblock_, 0);
+	resetBlock(ineqblock_, 0);
+}
+
+
+GurobiHybrid::GurobiHybrid(std::shared_ptr<GRBEnv> env, int nrvar, int nreq, int nrineq):
+	GurobiHybrid(std::move(env))
+{
+	problem(nrvar, nreq, nrineq);
+}
+
+
+void GurobiHybrid::problem(int nrvar, int nreq, int nrineq)
 {
 	GurobiCommon::problem(nrvar, nreq, nrineq);
+
+	objCached_ = false;
+	boundsCached_ = false;
+	resetBlock(eqblock_, nreq);
+	resetBlock(ineqblock_, nrineq);
 }
 
-void GurobiSparse::updateConstr(GRBConstr* constrs, const std::vector<GRBVar>& vars,
-			const Eigen::SparseMatrix<double>& A,
-			const Eigen::SparseVector<double>& b, int len)
+
+GurobiCommon::MemoryUsage GurobiHybrid::memoryUsage() const
 {
-	if(len > 0)
+	MemoryUsage usage = GurobiCommon::memoryUsage();
+	for(const ConstrBlock* block : {&eqblock_, &ineqblock_})
+	{
+		const CoeffPattern& pattern = block->pattern;
+		usage.wrapper += bytes(block->dense) + bytes(pattern.outer) + bytes(pattern.inner)
+			+ bytes(pattern.constrs) + bytes(pattern.vars);
+	}
+	usage.scratch += bytes(coeffConstrs_) + bytes(coeffVars_) + bytes(coeffVals_);
+	return usage;
+}
+
+void GurobiHybrid::compact()
+{
+	GurobiCommon::compact();
+	release(coeffConstrs_);
+	release(coeffVars_);
+	release(coeffVals_);
+}
+
+
+void GurobiHybrid::resetBlock(ConstrBlock& block, int len)
+{
+	// New constraints have no coefficients, in both storages
+	resetPattern(block.pattern);
+	block.dense.setZero(len, nrvar_);
+	block.denseValid = true;
+}
+
+
+void GurobiHybrid::updateObjective(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C)
+{
+	assert(Q.rows() == nrvar_ && Q.cols() == nrvar_);
+	assert(C.rows() == nrvar_);
+
+	ScopedTimer timer(collectStats_, stats_.objectiveTime);
+	if(objCached_ && Q == Q_)
+	{
+		// Only the linear coefficients that changed
+		updateChanged(GRB_DoubleAttr_Obj, vars_.data(), C_, C, true);
+		return;
+	}
+
+	GRBQuadExpr qexpr;
+	for(int j = 0; j < nrvar_; ++j)
 	{
-		//Update constrs
-		std::vector<double> zeros(static_cast<size_t>(len), 0.0);
-		for(int k = 0; k < A.outerSize(); ++k)
+		for(int i = 0; i < nrvar_; ++i)
 		{
-			model_.chgCoeffs(constrs, vars.data()+len*k, zeros.data(), len);
-			for (SparseMatrix<double>::InnerIterator it(A,k); it; ++it)
+			if(Q(i, j) != 0.)
 			{
-				model_.chgCoeff(*(constrs+it.row()), *(vars_+it.col()), it.value());
+				qexpr.addTerm(0.5*Q(i, j), vars_[i], vars_[j]);
 			}
 		}
-
-		//Update RHSes
-		for(SparseVector<double>::InnerIterator it(b); it; ++it)
-		{
-			(constrs+it.row())->set(GRB_DoubleAttr_RHS, it.value());
-		}
 	}
+
+	GRBLinExpr lexpr;
+	lexpr.addTerms(C.data(), vars_.data(), nrvar_);
+	model_.setObjective(qexpr + lexpr);
+	++stats_.apiCalls;
+	stats_.coeffsChanged += qexpr.size() + nrvar_;
+
+	Q_ = Q;
+	C_ = C;
+	objCached_ = true;
 }
 
 
-bool GurobiSparse::solve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
-	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
-	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
-	const VectorXd& XL, const VectorXd& XU)
+void GurobiHybrid::updateObjective(const SparseMatrix<double>& Q, const Ref<const VectorXd>& C)
 {
+	assert(Q.rows() == nrvar_ && Q.cols() == nrvar_);
+	assert(C.rows() == nrvar_);
 
-	//Objective: quadratic terms
+	ScopedTimer timer(collectStats_, stats_.objectiveTime);
 	GRBQuadExpr qexpr;
-	for(int k = 0; k<Q.outerSize(); ++k)
+	for(int k = 0; k < Q.outerSize(); ++k)
 	{
-		for (SparseMatrix<double>::InnerIterator it(Q,k); it; ++it)
+		for(SparseMatrix<double>::InnerIterator it(Q, k); it; ++it)
 		{
-			qexpr.addTerm(0.5*it.value(), *(vars_+it.row()), *(vars_+it.col()));
+			qexpr.addTerm(0.5*it.value(), vars_[it.row()], vars_[it.col()]);
 		}
 	}
 
-	//Objective: linear terms
-	for (SparseVector<double>::InnerIterator it(C); it; ++it)
+	GRBLinExpr lexpr;
+	lexpr.addTerms(C.data(), vars_.data(), nrvar_);
+	model_.setObjective(qexpr + lexpr);
+	++stats_.apiCalls;
+	stats_.coeffsChanged += qexpr.size() + nrvar_;
+
+	objCached_ = false;
+}
+
+
+void GurobiHybrid::updateBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	assert(XL.rows() == nrvar_ && XU.rows() == nrvar_);
+
+	ScopedTimer timer(collectStats_, stats_.boundsTime);
+	updateChanged(GRB_DoubleAttr_LB, vars_.data(), XL_, XL, boundsCached_);
+	updateChanged(GRB_DoubleAttr_UB, vars_.data(), XU_, XU, boundsCached_);
+	boundsCached_ = true;
+}
+
+
+void GurobiHybrid::updateConstr(GRBConstr* constrs, ConstrBlock& block, VectorXd& bcache,
+	const Ref<const MatrixXd>& A, const Ref<const VectorXd>& b, int len)
+{
+	assert(A.rows() == len);
+	assert(A.cols() == nrvar_);
+
+	if(len > 0)
 	{
-		qexpr.addTerm(it.value(), *(vars_+it.row()));
+		ScopedTimer timer(collectStats_, stats_.constraintsTime);
+
+		// Gather the changed coefficients, all sent in a single call
+		coeffConstrs_.clear();
+		coeffVars_.clear();
+		coeffVals_.clear();
+		for(int j = 0; j < nrvar_; ++j)
+		{
+			for(int i = 0; i < len; ++i)
+			{
+				if(!block.denseValid || A(i, j) != block.dense(i, j))
+				{
+					coeffConstrs_.push_back(constrs[i]);
+					coeffVars_.push_back(vars_[j]);
+					coeffVals_.push_back(A(i, j));
+				}
+			}
+		}
+
+		block.pattern.valid = false;
+		block.denseValid = false;
+		if(!coeffConstrs_.empty())
+		{
+			model_.chgCoeffs(coeffConstrs_.data(), coeffVars_.data(), coeffVals_.data(),
+				static_cast<int>(coeffConstrs_.size()));
+			++stats_.apiCalls;
+			stats_.coeffsChanged += static_cast<long>(coeffConstrs_.size());
+		}
+		block.dense = A;
+		block.denseValid = true;
 	}
 
-	model_.setObjective(qexpr);
+	updateRhs(constrs, block, bcache, b, len);
+}
 
-	//Bounds
-	model_.set(GRB_DoubleAttr_LB, vars_, XL.data(), nrvar_);
-	model_.set(GRB_DoubleAttr_UB, vars_, XU.data(), nrvar_);
 
-	//Update eq
-	updateConstr(eqconstr_, eqvars_, Aeq, Beq, nreq_);
-	updateConstr(ineqconstr_, ineqvars_, Aineq, Bineq, nrineq_);
+void GurobiHybrid::updateConstr(GRBConstr* constrs, ConstrBlock& block, VectorXd& bcache,
+	const SparseMatrix<double>& A, const Ref<const VectorXd>& b, int len)
+{
+	block.denseValid = false;
+	updateCoeffs(constrs, block.pattern, A, len);
+
+	updateRhs(constrs, block, bcache, b, len);
+}
 
-	model_.optimize();
 
-	status_ = model_.get(GRB_IntAttr_Status);
-	iter_ = model_.get(GRB_IntAttr_BarIterCount);
-	if (success()) {
-		double* result = model_.get(GRB_DoubleAttr_X, vars_, nrvar_);
-		X_ = Map<VectorXd>(result, nrvar_);
-		double* dual_eq = model_.get(GRB_DoubleAttr_Pi, eqconstr_, nreq_);
-		Yeq_ = Map<VectorXd>(dual_eq, nreq_);
-		double* dual_ineq = model_.get(GRB_DoubleAttr_Pi, ineqconstr_, nrineq_);
-		Yineq_ = Map<VectorXd>(dual_ineq, nrineq_);
-	}
+void GurobiHybrid::updateRhs(GRBConstr* constrs, ConstrBlock& block, VectorXd& bcache,
+	const Ref<const VectorXd>& b, int len)
+{
+	assert(b.rows() == len);
 
-	return success();
+	if(len > 0)
+	{
+		ScopedTimer timer(collectStats_, stats_.constraintsTime);
+		updateChanged(GRB_DoubleAttr_RHS, constrs, bcache, b, block.pattern.rhsValid);
+		block.pattern.rhsValid = true;
+	}
 }
 
 } // namespace Eigen
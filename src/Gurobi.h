@@ -16,6 +16,12 @@
 #pragma once
 
 // includes
+// std
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 // Eigen
 #include <Eigen/Core>
 #include <Eigen/Sparse>
@@ -29,35 +35,406 @@
 namespace Eigen
 {
 
+class GurobiRecorder;
+
 class GurobiCommon
 {
 public:
+	/// Warm start strategy used between two consecutive solves.
 	enum class WarmStatus : int
 	{
+		/// Let Gurobi reuse the information of the previous solve it still has.
 		DEFAULT = -1,
+		/// Give the previous primal solution as start (PStart, and Start for MIP).
 		PRIMAL = 0,
+		/// Give the previous dual solution as start (DStart).
 		DUAL = 1,
-		NONE = 2
+		/// Discard the previous solution: each solve starts from scratch.
+		NONE = 2,
+		/// Give both the previous primal and dual solutions as start.
+		PRIMAL_DUAL = 3,
+		/// Restore the simplex basis (VBasis and CBasis) of the previous solve.
+		BASIS = 4
+	};
+
+	/// Results available after a solve.
+	enum class ResultPolicy : int
+	{
+		/// Only optimal and suboptimal solves have a result.
+		OPTIMAL = 0,
+		/// Solves stopped by a limit (time, iteration, solution, node, objective
+		/// limit or user interruption) also have a result if Gurobi found a
+		/// solution: see solutionQuality().
+		BEST_AVAILABLE = 1
+	};
+
+	/// Quality of the result of the last solve.
+	enum class SolutionQuality : int
+	{
+		/// No result is available.
+		NONE = 0,
+		/// Best primal solution found before a limit was reached, no duals.
+		INCUMBENT = 1,
+		/// Best primal and dual solutions found before a limit was reached.
+		INCUMBENT_DUAL = 2,
+		/// Gurobi was unable to satisfy the optimality tolerances.
+		SUBOPTIMAL = 3,
+		/// Optimal solution (subject to tolerances).
+		OPTIMAL = 4
+	};
+
+	/// Outputs of a solve, combined into the extraction mask.
+	enum Output : int
+	{
+		/// Primal solution, always extracted.
+		OUTPUT_PRIMAL = 1,
+		/// Duals of the constraints.
+		OUTPUT_DUAL = 2,
+		/// Reduced costs of the variables.
+		OUTPUT_REDUCED_COSTS = 4,
+		/// Slacks of the inequalities.
+		OUTPUT_SLACKS = 8,
+		/// Simplex basis of the variables and constraints.
+		OUTPUT_BASIS = 16
+	};
+
+	/// Algorithm used for continuous models and MIP relaxations (Method parameter).
+	enum class Method : int
+	{
+		AUTOMATIC = -1,
+		PRIMAL_SIMPLEX = 0,
+		DUAL_SIMPLEX = 1,
+		BARRIER = 2,
+		CONCURRENT = 3,
+		DETERMINISTIC_CONCURRENT = 4
+	};
+
+	/// Presolve level (Presolve parameter).
+	enum class Presolve : int
+	{
+		AUTOMATIC = -1,
+		OFF = 0,
+		CONSERVATIVE = 1,
+		AGGRESSIVE = 2
+	};
+
+	/**
+	 Set of solver parameters, applied in one call by parameters().
+	 The default values are the Gurobi defaults.
+	 */
+	struct SolverParameters
+	{
+		EIGEN_GUROBI_API SolverParameters();
+
+		/// Single thread dual simplex without presolve, for small problems
+		/// solved in a loop.
+		EIGEN_GUROBI_API static SolverParameters realTime();
+		/// Barrier on all the cores, for large problems.
+		EIGEN_GUROBI_API static SolverParameters offline();
+
+		Method method;
+		/// Number of threads (0: automatic).
+		int threads;
+		Presolve presolve;
+		/// Barrier crossover strategy (-1: automatic, 0: off, 1 to 4: strategies).
+		int crossover;
+		/// Barrier convergence tolerance.
+		double barrierConvergenceTolerance;
+		/// Model scaling (-1: automatic, 0: off, 1 to 3: strategies).
+		int scaleFlag;
+		/// Care taken with numerical issues (0: automatic, 1 to 3: increasing).
+		int numericFocus;
+		double feasibilityTolerance;
+		double optimalityTolerance;
+	};
+
+	/// Timings and counters of a solve, from the end of the previous solve up
+	/// to the end of this one. Times are wall times in seconds.
+	struct SolveStats
+	{
+		EIGEN_GUROBI_API SolveStats();
+		EIGEN_GUROBI_API void reset();
+
+		/// Objective construction or update.
+		double objectiveTime;
+		/// Lower and upper bounds update.
+		double boundsTime;
+		/// Constraint coefficients and right hand sides update.
+		double constraintsTime;
+		/// Explicit model update, i.e. the application of the pending changes.
+		double updateTime;
+		/// Call to optimize() of Gurobi.
+		double optimizeTime;
+		/// Retrieval of the primal and dual results.
+		double extractionTime;
+
+		/// Number of calls to the Gurobi API that modify or query the model.
+		int apiCalls;
+		/// Number of objective and constraint coefficients sent to Gurobi.
+		long coeffsChanged;
+
+		/// Gurobi statistics: Runtime, IterCount, BarIterCount and NodeCount
+		/// attributes (the node count is only set for MIP models).
+		double runtime;
+		double simplexIterations;
+		int barrierIterations;
+		double nodeCount;
+	};
+
+	/**
+	 Outcome of a solve, given without throwing by solveResult() and the
+	 trySolve() methods. The views point to the outputs of the solver: they are
+	 valid until the next solve or change of dimensions.
+	 */
+	struct SolveResult
+	{
+		EIGEN_GUROBI_API SolveResult() noexcept;
+
+		/// Gurobi status of the model, GRB_LOADED after a failed solve.
+		int status;
+		/// 0, the Gurobi error code of a failed solve, or -1 for another error.
+		int error;
+		SolutionQuality quality;
+		/// True if dualEq() and dualIneq() are available.
+		bool hasDual;
+
+		/// True if X() is available (see ResultPolicy).
+		bool hasResult() const noexcept { return quality != SolutionQuality::NONE; }
+		/// Primal solution, empty without result.
+		Map<const VectorXd> X() const noexcept { return Map<const VectorXd>(x_, nrvar_); }
+		/// Duals of the equalities, empty without duals.
+		Map<const VectorXd> dualEq() const noexcept { return Map<const VectorXd>(yeq_, nreq_); }
+		/// Duals of the inequalities, empty without duals.
+		Map<const VectorXd> dualIneq() const noexcept { return Map<const VectorXd>(yineq_, nrineq_); }
+
+	private:
+		friend class GurobiCommon;
+
+		const double* x_;
+		const double* yeq_;
+		const double* yineq_;
+		int nrvar_, nreq_, nrineq_;
+	};
+
+	/**
+	 Handle on an asynchronous optimization started by optimizeAsync() or by
+	 the solveAsync() methods.
+	 While the optimization runs, the solver must not be used except through
+	 this handle. Once the optimization is done (poll() or wait() returned
+	 true, or cancel() was called) the results are retrieved as after a
+	 blocking solve. The handle cancels the optimization when destroyed.
+	 */
+	class AsyncSolve
+	{
+	public:
+		EIGEN_GUROBI_API AsyncSolve(AsyncSolve&& other);
+		EIGEN_GUROBI_API ~AsyncSolve();
+
+		/// @return True if the optimization is done, without blocking.
+		EIGEN_GUROBI_API bool poll();
+		/**
+		 Waits for the end of the optimization.
+		 @param timeout Maximum waiting time in seconds, negative to wait
+		 until the end of the optimization.
+		 @return True if the optimization is done.
+		 */
+		EIGEN_GUROBI_API bool wait(double timeout = -1.);
+		/// Stops the optimization and waits for Gurobi to return.
+		EIGEN_GUROBI_API void cancel();
+		/// @return True if the results were retrieved.
+		EIGEN_GUROBI_API bool done() const;
+
+	private:
+		friend class GurobiCommon;
+		explicit AsyncSolve(GurobiCommon* qp);
+		AsyncSolve(const AsyncSolve&) = delete;
+		AsyncSolve& operator=(const AsyncSolve&) = delete;
+		AsyncSolve& operator=(AsyncSolve&&) = delete;
+		void finish();
+
+	private:
+		GurobiCommon* qp_;
 	};
 
+	/// Progress of an optimization, reported to the progress callback.
+	struct Progress
+	{
+		/// Step reporting the progress: GRB_CB_SIMPLEX, GRB_CB_BARRIER,
+		/// GRB_CB_MIP or GRB_CB_MIPSOL.
+		int where;
+		/// Simplex or barrier iterations, or explored nodes for MIP.
+		double iterations;
+		/// Primal objective, best incumbent objective for MIP.
+		double primalObjective;
+		/// Dual objective, best bound for MIP (NaN for simplex).
+		double dualObjective;
+		/// Relative gap between the primal and dual objectives (NaN for simplex).
+		double gap;
+		/// Time since the start of the optimization, in seconds.
+		double runtime;
+		/// True if the incumbent was just updated (GRB_CB_MIPSOL).
+		bool newIncumbent;
+		/// True once a MIP incumbent was found by this optimization.
+		bool hasIncumbent;
+	};
+
+	/**
+	 Receives the progress of the optimization and the last MIP incumbent, of
+	 size nrvar, meaningful once Progress::hasIncumbent is true.
+	 @return False to stop the optimization, which ends with the
+	 GRB_INTERRUPTED status (see ResultPolicy::BEST_AVAILABLE).
+	 */
+	typedef std::function<bool(const Progress& progress, const VectorXd& incumbent)> ProgressCallback;
+
 public:
 	EIGEN_GUROBI_API GurobiCommon();
+	/**
+	 Creates the model in a shared environment, so that several solvers can be
+	 created without checking out a license for each of them.
+	 Gurobi environments are not thread safe: solvers sharing an environment
+	 must be created from one thread at a time (see GurobiSolverPool).
+
+	 @param env Environment, kept alive as long as the solver.
+	 */
+	EIGEN_GUROBI_API explicit GurobiCommon(std::shared_ptr<GRBEnv> env);
 
-	EIGEN_GUROBI_API int iter() const;
-	EIGEN_GUROBI_API int status() const;
-	EIGEN_GUROBI_API bool success() const;
+	EIGEN_GUROBI_API const std::shared_ptr<GRBEnv>& env() const;
 
+	EIGEN_GUROBI_API int iter() const noexcept;
+	EIGEN_GUROBI_API int nrvar() const noexcept;
+	EIGEN_GUROBI_API int nreq() const noexcept;
+	EIGEN_GUROBI_API int nrineq() const noexcept;
+	EIGEN_GUROBI_API int status() const noexcept;
+	EIGEN_GUROBI_API bool success() const noexcept;
+	/**
+	 Outcome of the last solve, never throws: the duals are extracted if they
+	 were not yet, and reported as unavailable if that fails.
+	 */
+	EIGEN_GUROBI_API SolveResult solveResult() const noexcept;
+
+	/**
+	 @return The primal solution of the last solve.
+	 @throw If no result is available (see resultPolicy()).
+	 */
 	EIGEN_GUROBI_API const VectorXd& result() const;
 	EIGEN_GUROBI_API const VectorXd& dual_eq() const;
 	EIGEN_GUROBI_API const VectorXd& dual_ineq() const;
 
+	/**
+	 Copies the result into a user provided vector, without any allocation.
+	 @param X Output vector, of size nrvar.
+	 */
+	EIGEN_GUROBI_API void result(Ref<VectorXd> X) const;
+	/// Same as result(Ref<VectorXd>) for the equality dual variables.
+	EIGEN_GUROBI_API void dual_eq(Ref<VectorXd> Yeq) const;
+	/// Same as result(Ref<VectorXd>) for the inequality dual variables.
+	EIGEN_GUROBI_API void dual_ineq(Ref<VectorXd> Yineq) const;
+
+	/**
+	 @return The reduced costs of the variables.
+	 @throw If no dual is available.
+	 */
+	EIGEN_GUROBI_API const VectorXd& reduced_costs() const;
+	/**
+	 @return The slacks \f$b_{ineq} - A_{ineq} x\f$ of the inequalities. For
+	 range inequalities, the slacks to their upper bound (infinite for the
+	 singleton rows).
+	 @throw If no result is available.
+	 */
+	EIGEN_GUROBI_API const VectorXd& slack_ineq() const;
+	/**
+	 @return The simplex basis status of the variables (GRB_BASIC,
+	 GRB_NONBASIC_LOWER...).
+	 @throw If the last solve has no basis (barrier without crossover, MIP).
+	 */
+	EIGEN_GUROBI_API const VectorXi& basis_var() const;
+	/// Same as basis_var() for the equalities.
+	EIGEN_GUROBI_API const VectorXi& basis_eq() const;
+	/// Same as basis_var() for the inequalities.
+	EIGEN_GUROBI_API const VectorXi& basis_ineq() const;
+
+	EIGEN_GUROBI_API int extraction() const;
+	/**
+	 Sets the outputs copied from Gurobi at the end of each successful solve,
+	 as a combination of Output flags (default: OUTPUT_PRIMAL | OUTPUT_DUAL).
+	 The other outputs are queried the first time they are read after the
+	 solve, which must happen before the model is modified.
+	 The primal solution, and the duals needed by the warm start, are always
+	 extracted.
+	 */
+	EIGEN_GUROBI_API void extraction(int outputs);
+
+	EIGEN_GUROBI_API GurobiCommon::SolutionQuality solutionQuality() const noexcept;
+	EIGEN_GUROBI_API GurobiCommon::ResultPolicy resultPolicy() const;
+	/// Sets the results available after a solve (default: ResultPolicy::OPTIMAL).
+	EIGEN_GUROBI_API void resultPolicy(GurobiCommon::ResultPolicy policy);
+
 	EIGEN_GUROBI_API GurobiCommon::WarmStatus warmStart() const;
 	EIGEN_GUROBI_API void warmStart(GurobiCommon::WarmStatus warmStatus);
+	/**
+	 Gives a primal start for the next solve only, overriding the warm start
+	 strategy for this solve.
+
+	 @param X Primal start, of size nrvar.
+	 */
+	EIGEN_GUROBI_API void warmStart(const VectorXd& X);
+	/**
+	 Gives a primal and dual start for the next solve only, overriding the warm
+	 start strategy for this solve.
+
+	 @param X Primal start, of size nrvar.
+	 @param Yeq Dual start of the equality constraints, of size nreq.
+	 @param Yineq Dual start of the inequality constraints, of size nrineq.
+	 */
+	EIGEN_GUROBI_API void warmStart(const VectorXd& X, const VectorXd& Yeq, const VectorXd& Yineq);
 
 	EIGEN_GUROBI_API std::string statusDescription() const;
 	EIGEN_GUROBI_API void inform() const;
 	EIGEN_GUROBI_API void displayOutput(bool doDisplay);
 
+	EIGEN_GUROBI_API int threads() const;
+	/// Sets the number of threads used by Gurobi for this model (0: automatic).
+	EIGEN_GUROBI_API void threads(int nrThreads);
+
+	EIGEN_GUROBI_API GurobiCommon::Method method() const;
+	EIGEN_GUROBI_API void method(GurobiCommon::Method m);
+
+	EIGEN_GUROBI_API GurobiCommon::Presolve presolve() const;
+	EIGEN_GUROBI_API void presolve(GurobiCommon::Presolve level);
+
+	EIGEN_GUROBI_API int crossover() const;
+	/// Sets the barrier crossover strategy (-1: automatic, 0: off, 1 to 4: strategies).
+	EIGEN_GUROBI_API void crossover(int strategy);
+
+	EIGEN_GUROBI_API double barrierConvergenceTolerance() const;
+	EIGEN_GUROBI_API void barrierConvergenceTolerance(double tol);
+
+	EIGEN_GUROBI_API int scaleFlag() const;
+	/// Sets the model scaling (-1: automatic, 0: off, 1 to 3: strategies).
+	EIGEN_GUROBI_API void scaleFlag(int flag);
+
+	EIGEN_GUROBI_API int numericFocus() const;
+	/// Sets the care taken with numerical issues (0: automatic, 1 to 3: increasing).
+	EIGEN_GUROBI_API void numericFocus(int focus);
+
+	/// Current values of all the parameters of SolverParameters.
+	EIGEN_GUROBI_API GurobiCommon::SolverParameters parameters() const;
+	/// Sets all the parameters of SolverParameters, e.g. a profile such as
+	/// SolverParameters::realTime().
+	EIGEN_GUROBI_API void parameters(const GurobiCommon::SolverParameters& params);
+
+	EIGEN_GUROBI_API double timeLimit() const;
+	/// Sets the time limit of a solve, in seconds.
+	EIGEN_GUROBI_API void timeLimit(double seconds);
+
+	EIGEN_GUROBI_API double iterationLimit() const;
+	/// Sets the limit on the number of simplex iterations of a solve.
+	EIGEN_GUROBI_API void iterationLimit(double nrIter);
+
+	EIGEN_GUROBI_API int barrierIterationLimit() const;
+	/// Sets the limit on the number of barrier iterations of a solve.
+	EIGEN_GUROBI_API void barrierIterationLimit(int nrIter);
+
 	EIGEN_GUROBI_API double feasibilityTolerance() const;
 	EIGEN_GUROBI_API void feasibilityTolerance(double tol);
 
@@ -66,28 +443,403 @@ public:
 
 	EIGEN_GUROBI_API void problem(int nrvar, int nreq, int nrineq);
 
+	/**
+	 Appends variables to the model, keeping the existing variables,
+	 constraints and warm start information. The new variables are continuous,
+	 with no objective and no constraint coefficients, and bounds [0, inf].
+	 @param nrvar Number of variables to add.
+	 */
+	EIGEN_GUROBI_API void addVariables(int nrvar);
+	/**
+	 Removes variables from the model. The remaining variables keep their
+	 order, their coefficients and their warm start information.
+	 @param indices Indices of the variables to remove, in any order.
+	 */
+	EIGEN_GUROBI_API void removeVariables(const std::vector<int>& indices);
+	/// Same as addVariables() for equality constraints, with a null right hand side.
+	EIGEN_GUROBI_API void addEqualities(int nreq);
+	/// Same as removeVariables() for equality constraints.
+	EIGEN_GUROBI_API void removeEqualities(const std::vector<int>& indices);
+	/// Same as addVariables() for inequality constraints, with a null right hand side.
+	EIGEN_GUROBI_API void addInequalities(int nrineq);
+	/// Same as removeVariables() for inequality constraints.
+	EIGEN_GUROBI_API void removeInequalities(const std::vector<int>& indices);
+
+	/**
+	 Writes the model to a file, to build a solver from it later without
+	 going through problem() and solve() (see the GurobiDense and GurobiSparse
+	 constructors taking a path).
+	 The parameters are written to path + ".prm", and the wrapper state (the
+	 dimensions and the warm start information) to path + ".idx".
+	 The variables and constraints are renamed after their index.
+
+	 @param path Model file, its extension gives the format (.mps, .lp, .rew,
+	 with an optional .gz, .bz2 or .7z compression).
+	 @throw If the index file cannot be written, or if the model is in the
+	 range form or holds the residuals of GurobiSparse::solveLeastSquares():
+	 save it after a regular solve.
+	 */
+	EIGEN_GUROBI_API void saveModel(const std::string& path);
+
 	EIGEN_GUROBI_API void setVariableType(int varIndex, char GRBType);
+	/**
+	 Sets the type of several variables in a single call.
+	 @param indices Indices of the variables.
+	 @param GRBTypes Type of each variable (GRB_CONTINUOUS, GRB_BINARY,
+	 GRB_INTEGER, GRB_SEMICONT or GRB_SEMIINT).
+	 */
+	EIGEN_GUROBI_API void setVariableTypes(const Ref<const VectorXi>& indices,
+		const std::vector<char>& GRBTypes);
+	/// Same as setVariableTypes() with the same type for all the variables.
+	EIGEN_GUROBI_API void setVariableTypes(const Ref<const VectorXi>& indices, char GRBType);
+
+	/// Relative gap of the last MIP solve.
+	EIGEN_GUROBI_API double mipGap() const;
+	/// Best known bound on the objective of the last MIP solve.
+	EIGEN_GUROBI_API double objBound() const;
+	/// Number of solutions found by the last solve (size of the solution pool).
+	EIGEN_GUROBI_API int solutionCount() const;
+	/**
+	 Retrieves a solution from the solution pool of the last MIP solve.
+	 No dual variables are available for models with integer variables.
+	 @param solNumber Index of the solution, from 0 (best) to solutionCount()-1.
+	 @param X Receives the solution, of size nrvar.
+	 @return The objective value of the solution.
+	 */
+	EIGEN_GUROBI_API double poolSolution(int solNumber, Ref<VectorXd> X);
+
+	/**
+	 Optimizes the model as it is currently defined and retrieves the result
+	 (primal and dual variables) on success.
+
+	 @return True if solved successfully, False otherwise.
+	 */
+	EIGEN_GUROBI_API bool optimize();
+	/// Same as optimize(), catching the errors: see SolveResult::error.
+	EIGEN_GUROBI_API SolveResult tryOptimize() noexcept;
+
+	/**
+	 Starts the optimization of the model as it is currently defined, and
+	 returns immediately. status() is GRB_INPROGRESS until the returned handle
+	 reports the end of the optimization.
+	 The optimize time of the statistics is not measured for asynchronous
+	 optimizations (Gurobi runtime is).
+	 */
+	EIGEN_GUROBI_API AsyncSolve optimizeAsync();
+
+	/**
+	 Applies all the modifications made to the model since the last update
+	 in a single Gurobi update. optimize() does it anyway, commit() lets the
+	 update happen before the solve is decided, and be timed separately.
+	 */
+	EIGEN_GUROBI_API void commit();
+
+	EIGEN_GUROBI_API bool collectStats() const;
+	/**
+	 Enables or disables the collection of the solve statistics (default:
+	 disabled). The counters are always maintained, the timings and Gurobi
+	 statistics are only collected when enabled.
+	 */
+	EIGEN_GUROBI_API void collectStats(bool doCollect);
+	/// Statistics of the last solve.
+	EIGEN_GUROBI_API const SolveStats& stats() const;
+
+	/// Memory used by a solver.
+	struct MemoryUsage
+	{
+		/// Bytes of the problem data, results and warm start kept by the wrapper.
+		std::size_t wrapper;
+		/// Bytes of the scratch buffers, released by compact().
+		std::size_t scratch;
+		/// Memory allocated by Gurobi in the environment of the model, and its
+		/// peak, in GB (MemUsed and MaxMemUsed, 0 before Gurobi 9.5).
+		double gurobi, gurobiPeak;
+	};
+
+	/// Memory used by the wrapper and by Gurobi.
+	EIGEN_GUROBI_API MemoryUsage memoryUsage() const;
+	/**
+	 Releases the scratch buffers, for solvers kept alive between rare
+	 solves. The problem data, caches and results are kept, the buffers are
+	 allocated again by the next solve that needs them.
+	 */
+	EIGEN_GUROBI_API void compact();
+
+	/**
+	 Sets the function called by Gurobi during the optimizations, an empty
+	 function removes it. Without a callback Gurobi is not interrupted at all.
+	 The callback runs in the optimization thread, also for optimizeAsync().
+	 */
+	EIGEN_GUROBI_API void progressCallback(ProgressCallback callback);
+
+	/// Recorder of the solves, null if they are not recorded.
+	EIGEN_GUROBI_API const std::shared_ptr<GurobiRecorder>& recorder() const;
+	/**
+	 Records the following solves of GurobiDense and GurobiSparse in a solve
+	 log, null to stop recording: the solve() calls taking the objective, the
+	 constraints and the bounds, solveAsync(), and each instance of
+	 solveParametric().
+	 The other entry points that change the model cannot be replayed, and
+	 throw while a recorder is attached: the range inequality solves,
+	 GurobiSparse::solveLeastSquares() and loadProblem(), and for GurobiDense
+	 the solve() without objective, updateObjective(), updateLinearObjective()
+	 and the commit of staged data.
+	 @see GurobiRecorder
+	 */
+	EIGEN_GUROBI_API void recorder(std::shared_ptr<GurobiRecorder> recorder);
+
+protected:
+	/**
+	 Runs solve() and returns solveResult(). Any exception is caught, and
+	 leaves the solver without result.
+	 */
+	template<typename Solve>
+	SolveResult guardedSolve(Solve&& solve) noexcept
+	{
+		error_ = 0;
+		try
+		{
+			solve();
+		}
+		catch(const GRBException& e)
+		{
+			solveFailed(e.getErrorCode());
+		}
+		catch(...)
+		{
+			solveFailed(-1);
+		}
+		return solveResult();
+	}
+	void solveFailed(int error) noexcept;
+
+	/// Forwards the Gurobi callbacks to the progress callback.
+	class ProgressAdapter : public GRBCallback
+	{
+	public:
+		explicit ProgressAdapter(GurobiCommon& qp);
+
+	protected:
+		void callback() override;
+
+	private:
+		GurobiCommon& qp_;
+	};
+
+	/// Sparsity pattern (CSC) of the coefficients currently in a block of
+	/// constraints of the model, with the matching constraint and variable
+	/// handles of every nonzero.
+	struct CoeffPattern
+	{
+		std::vector<int> outer, inner;
+		std::vector<GRBConstr> constrs;
+		std::vector<GRBVar> vars;
+		/// False when the model coefficients may differ from the pattern.
+		bool valid;
+		/// False when the model right hand sides may differ from their cache.
+		bool rhsValid;
+	};
+
+	/// Inequality with a single coefficient, sent as bounds of its variable.
+	struct Singleton
+	{
+		int row, var;
+		double coeff;
+		/// True if the row sets the lower (upper) bound of the variable.
+		bool lower, upper;
+	};
+
+protected:
+	/**
+	 Loads a model written by saveModel().
+	 @throw If the index file cannot be read or does not match the model.
+	 */
+	GurobiCommon(std::shared_ptr<GRBEnv> env, const std::string& path);
+
+	/// Applies the staged data, the pending modifications and the warm start.
+	void startOptimize();
+	/**
+	 Sends the data staged by a derived solver before an optimization, so
+	 that optimize() and optimizeAsync() never solve the model without them.
+	 Nothing is staged in the base solver.
+	 */
+	virtual void commitStaged();
+	/// Retrieves the status and results of the last optimization.
+	bool finishOptimize();
+	void applyWarmStart();
+	void saveBasis();
+	/**
+	 Copies the values of an attribute of len variables or constraints into the
+	 preallocated out.
+	 Small blocks, or all of them if elementwiseAttr_ is set, are queried one
+	 value at a time: this does not allocate any memory, but costs one library
+	 call per value. Larger blocks are queried in a single call with the array
+	 version of GRBModel::get, whose result is allocated by Gurobi, copied into
+	 out and freed.
+	 @return The number of Gurobi calls.
+	 */
+	template<typename T, typename Attr, typename Handle>
+	int getAttr(Attr attr, const Handle* handles, int len, T* out) const;
+	/**
+	 Sends the entries of value that differ from cache to an attribute of the
+	 handles, with one call per range of changed entries, then updates the
+	 cache. Everything is sent if cached is false.
+	 */
+	template<typename Handle>
+	void updateChanged(GRB_DoubleAttr attr, const Handle* handles, VectorXd& cache,
+		const Ref<const VectorXd>& value, bool cached);
+	/// Stores the result and status of instance k of a parametric solve.
+	void storeInstance(Index k, Ref<MatrixXd> X, std::vector<int>& status) const;
+	/// Adds variables to the model and to vars_, leaving the caches as is.
+	void appendVars(int nrvar);
+	/// Adds constraints to the model and to constrs, leaving the caches as is.
+	void appendConstrs(std::vector<GRBConstr>& constrs, int& len, int nrconstr, char sense);
+	void addConstraints(std::vector<GRBConstr>& constrs, VectorXd& b, VectorXd& y,
+		VectorXi& basis, int& len, int nrconstr, char sense);
+	void removeConstraints(std::vector<GRBConstr>& constrs, VectorXd& b, VectorXd& y,
+		VectorXi& basis, int& len, const std::vector<int>& indices);
+
+	/// Empty pattern, for constraints without coefficients.
+	void resetPattern(CoeffPattern& pattern);
+	/**
+	 Sends the coefficients of a compressed or uncompressed sparse block,
+	 leaving the right hand sides untouched. If the pattern is unchanged only
+	 the values are sent, otherwise the coefficients that left the pattern
+	 are zeroed first.
+	 */
+	void updateCoeffs(GRBConstr* constrs, CoeffPattern& pattern,
+		const SparseMatrix<double>& A, int len);
+
+	/**
+	 Switches the inequalities between the rows Aineq x <= Bineq and the
+	 range rows Aineq x - s = 0, with one slack variable s per row bounded by
+	 the range. The coefficients of Aineq are kept, the right hand sides are
+	 set to zero.
+	 */
+	void rangeInequalities(bool ranged);
+	/// Adds the slacks of the range rows [first, nrineq_).
+	void appendRangeVars(int first);
+	/**
+	 Moves the bounds of the singleton rows in singletons_ to their
+	 variables: fills singletonXL_, singletonXU_ with the tightened variable
+	 bounds and singletonL_, singletonU_ with the ranges, free for the
+	 singleton rows.
+	 */
+	void boundSingletons(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU,
+		const Ref<const VectorXd>& L, const Ref<const VectorXd>& U);
+	/// Sends the changed slack bounds.
+	void updateRanges(const Ref<const VectorXd>& L, const Ref<const VectorXd>& U);
+	/// Duals of the singleton rows, from the reduced costs of their variables.
+	void singletonDuals() const;
+	/**
+	 Queries the outputs of the last solve that are not extracted yet.
+	 @param outputs Combination of Output flags.
+	 @return The number of Gurobi calls.
+	 @throw If the model no longer has the outputs.
+	 */
+	int extract(int outputs) const;
 
 protected:
 	MatrixXd Q_;
-	VectorXd C_, Beq_, Bineq_, X_, Yeq_, Yineq_;
+	VectorXd C_, Beq_, Bineq_, XL_, XU_, X_;
+	/// Outputs of the last solve, some extracted on demand.
+	mutable VectorXd Yeq_, Yineq_, reducedCosts_, slackIneq_;
 	int status_, nrvar_, nreq_, nrineq_, iter_;
+	/// Error of the last guarded solve, see SolveResult::error.
+	int error_;
+
+	SolutionQuality quality_;
+	ResultPolicy resultPolicy_;
+	WarmStatus warmStatus_;
+	/// True if X_, Yeq_, Yineq_ hold the solution of the current problem.
+	bool hasSolution_;
+	/// True if the last result has duals, extracted into Yeq_, Yineq_ when needed.
+	bool hasDual_;
+	/// True if vbasis_, eqbasis_ and ineqbasis_ hold the basis of the current problem.
+	bool hasBasis_;
+	/// User start for the next solve: 0 none, 1 primal, 2 primal and dual.
+	int userStart_;
+	/// Outputs extracted at the end of a solve, see extraction().
+	int extraction_;
+	/// Outputs of the last solve already extracted.
+	mutable int extracted_;
+	VectorXd startX_, startYeq_, startYineq_;
+	mutable VectorXi vbasis_, eqbasis_, ineqbasis_;
 
-	GRBEnv env_;
+	bool collectStats_;
+	/// Number of values up to which getAttr() queries them one by one.
+	static const int elementwiseAttrMax_ = 64;
+	/// True to query all the attributes one value at a time, see getAttr().
+	bool elementwiseAttr_;
+	/// Statistics of the current solve, moved to lastStats_ by optimize().
+	SolveStats stats_, lastStats_;
+
+	std::shared_ptr<GRBEnv> env_;
 	GRBModel model_;
 
-	GRBVar* vars_;
-	std::vector<GRBVar> lvars_, rvars_, eqvars_, ineqvars_;
-	GRBConstr* eqconstr_;
-	GRBConstr* ineqconstr_;
+	std::vector<GRBVar> vars_;
+	/// Scratch column of variable handles, used to change a whole column of
+	/// constraint coefficients in a single call.
+	std::vector<GRBVar> colvars_;
+	/// Scratch lists of the coefficients zeroed by updateCoeffs().
+	std::vector<GRBConstr> zeroConstrs_;
+	std::vector<GRBVar> zeroVars_;
+	std::vector<double> zeros_;
+	std::vector<GRBConstr> eqconstr_;
+	std::vector<GRBConstr> ineqconstr_;
+
+	/// True if the inequalities are range rows, see rangeInequalities().
+	bool ranged_;
+	/// True if BineqL_ and BineqU_ hold the slack bounds of the model.
+	bool rangeCached_;
+	std::vector<GRBVar> rangevars_;
+	VectorXd BineqL_, BineqU_, rangeX_;
+	VectorXi rangebasis_;
+	std::vector<Singleton> singletons_;
+	VectorXd singletonXL_, singletonXU_, singletonL_, singletonU_;
+	/// Scratch flags of the variables whose bounds are owned by a singleton row.
+	std::vector<char> singletonOwned_;
+
+	ProgressCallback progressCallback_;
+	std::unique_ptr<ProgressAdapter> progressAdapter_;
+	/// Last MIP incumbent given to the progress callback.
+	VectorXd incumbent_;
+	Progress progress_;
+
+	std::shared_ptr<GurobiRecorder> recorder_;
 };
 
 
 class GurobiDense : public GurobiCommon
 {
+public:
+	/// Structure of the quadratic objective matrix, see hessianStructure().
+	enum class HessianStructure : int
+	{
+		/// Detected at each objective rebuild: DIAGONAL, SYMMETRIC or GENERAL.
+		AUTO = 0,
+		/// Any matrix, all the nonzero coefficients are read.
+		GENERAL = 1,
+		/// Symmetric matrix, only the upper triangle is read.
+		SYMMETRIC = 2,
+		/// Symmetric matrix with a band structure, only the upper band is read.
+		BANDED = 3,
+		/// Diagonal matrix, only the diagonal is read.
+		DIAGONAL = 4
+	};
+
 public:
 	EIGEN_GUROBI_API GurobiDense();
 	EIGEN_GUROBI_API GurobiDense(int nrvar, int nreq, int nrineq);
+	EIGEN_GUROBI_API explicit GurobiDense(std::shared_ptr<GRBEnv> env);
+	EIGEN_GUROBI_API GurobiDense(std::shared_ptr<GRBEnv> env, int nrvar, int nreq, int nrineq);
+	/**
+	 Loads a model written by GurobiCommon::saveModel(), which can be solved
+	 right away with optimize(). The first solve() sends all the data.
+	 @param path Model file given to saveModel().
+	 */
+	EIGEN_GUROBI_API explicit GurobiDense(const std::string& path);
+	EIGEN_GUROBI_API GurobiDense(std::shared_ptr<GRBEnv> env, const std::string& path);
 
 
 	/**
@@ -104,6 +856,14 @@ public:
 	 */
 	EIGEN_GUROBI_API void problem(int nrvar, int nreq, int nrineq);
 
+	/// Same as the GurobiCommon resize functions, keeping the cached data up to date.
+	EIGEN_GUROBI_API void addVariables(int nrvar);
+	EIGEN_GUROBI_API void removeVariables(const std::vector<int>& indices);
+	EIGEN_GUROBI_API void addEqualities(int nreq);
+	EIGEN_GUROBI_API void removeEqualities(const std::vector<int>& indices);
+	EIGEN_GUROBI_API void addInequalities(int nrineq);
+	EIGEN_GUROBI_API void removeInequalities(const std::vector<int>& indices);
+
 
 	/**
      Solves a model with quadratic objective:
@@ -139,15 +899,220 @@ public:
 	 @param XU Vector of upper boundaries of the variables \f$x_u\f$
 	 @return True if solved successfully, False otherwise.
 	 */
-	EIGEN_GUROBI_API bool solve(const MatrixXd& Q, const VectorXd& C,
-		const MatrixXd& Aeq, const VectorXd& Beq,
-		const MatrixXd& Aineq, const VectorXd& Bineq,
-		const VectorXd& XL, const VectorXd& XU);
+	EIGEN_GUROBI_API bool solve(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+		const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Same as solve(), never throws: the Gurobi and wrapper errors are caught
+	 and reported by SolveResult::error, and the result is read from the
+	 returned SolveResult, so failed and infeasible solves do not unwind.
+	 */
+	EIGEN_GUROBI_API SolveResult trySolve(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+		const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU) noexcept;
+
+	/**
+	 Solves the model with the objective set by the last call to
+	 updateObjective() or updateLinearObjective().
+	 The constraint and bound parameters are the same as in the full solve().
+
+	 @return True if solved successfully, False otherwise.
+	 */
+	EIGEN_GUROBI_API bool solve(const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Same as the full solve() with range inequalities:
+	 \f[
+	 b_{\text{l}} \leq A_{\text{ineq}} x \leq b_{\text{u}}
+	 \f]
+	 Each range is a single row of the model, with a slack variable bounded
+	 by the range, instead of two opposite inequalities: the model has nrineq
+	 more variables than the problem, the slack columns. The rows with a
+	 single nonzero coefficient are sent as bounds of their variable instead,
+	 with their duals recovered from the reduced costs. dual_ineq() has the
+	 sign of the active side of the range, as if it was a \f$\leq\f$ or
+	 \f$\geq\f$ row. The singleton rows are only searched again when the
+	 zero pattern of Aineq changes.
+	 The problem keeps this form until the next solve without ranges.
+	 Models with ranges cannot be saved with saveModel().
+
+	 @param BineqL Lower bounds \f$b_l\f$ of the inequalities, -GRB_INFINITY if unbounded.
+	 @param BineqU Upper bounds \f$b_u\f$ of the inequalities, GRB_INFINITY if unbounded.
+	 The other parameters are the same as in the full solve().
+	 */
+	EIGEN_GUROBI_API bool solve(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+		const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& BineqL,
+		const Ref<const VectorXd>& BineqU,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Solves a series of instances of the same problem that only differ by
+	 their linear objective and right hand sides, keeping the matrices in the
+	 model.
+	 The first instance is solved with solve(), the next ones only send the
+	 linear objective and right hand side entries that differ from the
+	 previous instance, and are warm started according to warmStart().
+
+	 @param Cs Linear objectives, one column per instance.
+	 @param Beqs Equality right hand sides, one column per instance.
+	 @param Bineqs Inequality right hand sides, one column per instance.
+	 @param X Receives the result of each instance in a column, NaN for the
+	 instances that were not solved successfully.
+	 The data given with a single column are shared by all the instances, the
+	 other parameters are the same as in solve().
+	 @return The status of each instance.
+	 */
+	EIGEN_GUROBI_API std::vector<int> solveParametric(const Ref<const MatrixXd>& Q, const Ref<const MatrixXd>& Cs,
+		const Ref<const MatrixXd>& Aeq, const Ref<const MatrixXd>& Beqs,
+		const Ref<const MatrixXd>& Aineq, const Ref<const MatrixXd>& Bineqs,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU, Ref<MatrixXd> X);
+
+	/**
+	 Same as solve() but returns as soon as the optimization is started.
+	 See GurobiCommon::AsyncSolve.
+	 */
+	EIGEN_GUROBI_API AsyncSolve solveAsync(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+		const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Sets the objective \f$\frac{1}{2} x^TQx + c^Tx\f$.
+	 When incremental objective updates are enabled, the quadratic part is only
+	 rebuilt if \f$Q\f$ differs from the last one, otherwise only the changed
+	 linear coefficients are sent to Gurobi.
+
+	 @param Q Dense matrix \f$Q\f$ with the quadratic coefficients.
+	 @param C Linear part of the objective function, i.e. \f$c^T\f$
+	 */
+	EIGEN_GUROBI_API void updateObjective(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C);
+
+	/**
+	 Changes the linear part of the objective only, keeping the quadratic part
+	 of the last updateObjective() call.
+	 Only the coefficients that differ from the last ones are sent to Gurobi.
+
+	 @param C Linear part of the objective function, i.e. \f$c^T\f$
+	 */
+	EIGEN_GUROBI_API void updateLinearObjective(const Ref<const VectorXd>& C);
+
+	EIGEN_GUROBI_API bool incrementalObjective() const;
+	/**
+	 Enables or disables the caching of the last objective (default: enabled).
+	 When disabled, the whole objective is rebuilt at every solve.
+	 */
+	EIGEN_GUROBI_API void incrementalObjective(bool incremental);
+
+	EIGEN_GUROBI_API GurobiDense::HessianStructure hessianStructure() const;
+	EIGEN_GUROBI_API int hessianBandwidth() const;
+	/**
+	 Declares the structure of the Q matrices given to updateObjective() and
+	 solve() (default: HessianStructure::AUTO). The objective terms are built
+	 from the part of Q given by the structure: the symmetric structures give a
+	 single combined term for each pair of off-diagonal coefficients. The other
+	 coefficients of Q are ignored.
+	 @param structure Structure of Q.
+	 @param bandwidth Number of nonzero diagonals above the main one, for
+	 HessianStructure::BANDED.
+	 */
+	EIGEN_GUROBI_API void hessianStructure(GurobiDense::HessianStructure structure, int bandwidth = 0);
+
+	/**
+	 Starts staging the data of the next problem, dropping the changes
+	 staged and not committed yet.
+	 The set functions below only copy their data in the wrapper, nothing is
+	 sent to Gurobi until commit(), or optimize() which commits them. The
+	 staged changes can be dropped with beginUpdate() if the problem is not
+	 solved after all. The solve() functions replace the staged data they are
+	 given: those of the constraints and bounds, and also those of the
+	 objective for the solves taking Q and C.
+	 */
+	EIGEN_GUROBI_API void beginUpdate();
+	/// Stages the quadratic part of the objective, see updateObjective().
+	EIGEN_GUROBI_API void setQ(const Ref<const MatrixXd>& Q);
+	/// Stages the linear part of the objective, see updateLinearObjective().
+	EIGEN_GUROBI_API void setC(const Ref<const VectorXd>& C);
+	/// Stages the equalities.
+	EIGEN_GUROBI_API void setAeq(const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq);
+	/// Stages the inequalities.
+	EIGEN_GUROBI_API void setAineq(const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq);
+	/// Stages the bounds of the variables.
+	EIGEN_GUROBI_API void setBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	/// True if changes were staged since the last beginUpdate() or commit().
+	EIGEN_GUROBI_API bool updatePending() const;
+	/**
+	 Sends the staged changes, only the data that differ from the model, then
+	 applies them in a single Gurobi update. The problem can then be solved
+	 with optimize().
+	 The data that are not staged are kept. A Q staged without C, or only some
+	 of the constraints and bounds, need a previous solve, commit() or
+	 updateObjective() to provide the rest.
+	 */
+	EIGEN_GUROBI_API void commit();
+
+	/// Same as GurobiCommon::memoryUsage(), with the dense caches.
+	EIGEN_GUROBI_API MemoryUsage memoryUsage() const;
+	/// Same as GurobiCommon::compact(), also releasing the staging buffers
+	/// when nothing is staged.
+	EIGEN_GUROBI_API void compact();
 
 private:
-	void updateConstr(GRBConstr* constrs, const std::vector<GRBVar>& vars,
-		const Eigen::MatrixXd& A, const Eigen::VectorXd& b, int len);
+	/// Data staged for the next commit().
+	enum StagedData
+	{
+		STAGED_Q = 1,
+		STAGED_C = 2,
+		STAGED_EQ = 4,
+		STAGED_INEQ = 8,
+		STAGED_BOUNDS = 16
+	};
+
+	/// updateObjective() and updateLinearObjective() of the solves, which are recorded.
+	void sendObjective(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C);
+	void sendLinearObjective(const Ref<const VectorXd>& C);
+	void updateData(const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	void updateBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU, bool cached);
+	void updateConstr(GRBConstr* constrs, MatrixXd& Acache, VectorXd& bcache,
+		const Ref<const MatrixXd>& A, const Ref<const VectorXd>& b, int len, bool cached);
+	/// Finds the singleton rows of Aineq, into singletons_ and singletonRow_.
+	void findSingletons(const Ref<const MatrixXd>& Aineq);
+	/**
+	 Sends the changed columns of the range rows, keeping the singleton rows
+	 null, if the singleton rows and the zero pattern of the other rows of
+	 Aineq are those of Aineq_.
+	 @return false if the pattern changed, nothing is sent then.
+	 */
+	bool updateRangeCoeffs(const Ref<const MatrixXd>& Aineq);
+	/// Sends the staged data, without the Gurobi update.
+	void commitStaged() override;
 
+private:
+	bool incrementalObj_, objCached_;
+	HessianStructure hessianStructure_;
+	int hessianBandwidth_;
+	/// True if Aeq_, Aineq_, Beq_, Bineq_, XL_ and XU_ hold the model data.
+	bool dataCached_;
+	MatrixXd Aeq_, Aineq_;
+	/// Aineq without the singleton rows.
+	MatrixXd Arange_;
+	/// True if singletons_ and singletonRow_ hold the singleton rows of Aineq_.
+	bool singletonsCached_;
+	/// Index in singletons_ of each inequality, -1 for the other rows.
+	VectorXi singletonRow_;
+	/// Combination of StagedData flags.
+	int staged_;
+	MatrixXd stagedQ_, stagedAeq_, stagedAineq_;
+	VectorXd stagedC_, stagedBeq_, stagedBineq_, stagedXL_, stagedXU_;
+	std::vector<GRBVar> objVars_;
+	std::vector<double> objVals_;
 };
 
 
@@ -156,17 +1121,280 @@ class GurobiSparse : public GurobiCommon
 public:
 	EIGEN_GUROBI_API GurobiSparse();
 	EIGEN_GUROBI_API GurobiSparse(int nrvar, int nreq, int nrineq);
+	EIGEN_GUROBI_API explicit GurobiSparse(std::shared_ptr<GRBEnv> env);
+	EIGEN_GUROBI_API GurobiSparse(std::shared_ptr<GRBEnv> env, int nrvar, int nreq, int nrineq);
+	/**
+	 Loads a model written by GurobiCommon::saveModel(), which can be solved
+	 right away with optimize(). The sparsity patterns, bounds and right hand
+	 sides are read back from the model, so the next solve() only sends what
+	 changed.
+	 @param path Model file given to saveModel().
+	 */
+	EIGEN_GUROBI_API explicit GurobiSparse(const std::string& path);
+	EIGEN_GUROBI_API GurobiSparse(std::shared_ptr<GRBEnv> env, const std::string& path);
 
 	EIGEN_GUROBI_API void problem(int nrvar, int nreq, int nrineq);
 
+	/// Same as the GurobiCommon resize functions, keeping the sparsity patterns up to date.
+	EIGEN_GUROBI_API void addVariables(int nrvar);
+	EIGEN_GUROBI_API void removeVariables(const std::vector<int>& indices);
+	EIGEN_GUROBI_API void addEqualities(int nreq);
+	EIGEN_GUROBI_API void removeEqualities(const std::vector<int>& indices);
+	EIGEN_GUROBI_API void addInequalities(int nrineq);
+	EIGEN_GUROBI_API void removeInequalities(const std::vector<int>& indices);
+
 	EIGEN_GUROBI_API bool solve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
 		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
 		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
-		const VectorXd& XL, const VectorXd& XU);
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	/// Same as GurobiDense::trySolve() for sparse matrices.
+	EIGEN_GUROBI_API SolveResult trySolve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU) noexcept;
+
+	/**
+	 Same as GurobiDense::solve() with range inequalities, for sparse matrices.
+	 The singleton rows are found from the nonzeros of Aineq.
+	 */
+	EIGEN_GUROBI_API bool solve(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const Ref<const VectorXd>& BineqL,
+		const Ref<const VectorXd>& BineqU,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Same as GurobiDense::solveParametric() for sparse matrices.
+
+	 @param Cs Linear objectives, one column per instance.
+	 @param Beqs Equality right hand sides, one column per instance.
+	 @param Bineqs Inequality right hand sides, one column per instance.
+	 @param X Receives the result of each instance in a column, NaN for the
+	 instances that were not solved successfully.
+	 The data given with a single column are shared by all the instances, the
+	 other parameters are the same as in solve().
+	 @return The status of each instance.
+	 */
+	EIGEN_GUROBI_API std::vector<int> solveParametric(const SparseMatrix<double>& Q, const Ref<const MatrixXd>& Cs,
+		const SparseMatrix<double>& Aeq, const Ref<const MatrixXd>& Beqs,
+		const SparseMatrix<double>& Aineq, const Ref<const MatrixXd>& Bineqs,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU, Ref<MatrixXd> X);
+
+	/**
+	 Same as solve() but returns as soon as the optimization is started.
+	 See GurobiCommon::AsyncSolve.
+	 */
+	EIGEN_GUROBI_API AsyncSolve solveAsync(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Solves a least squares problem:
+	 \f[
+	 \underset{x}{\text{min}}\; \frac{1}{2} \| J x - r \|^2
+	 \f]
+	 subject to the same constraints as solve(), without forming \f$J^T J\f$:
+	 the residuals \f$y = J x - r\f$ are added to the model as J.rows() free
+	 variables, constrained by as many equalities, with the objective
+	 \f$\frac{1}{2} y^T y\f$. The model has O(nnz(J)) coefficients.
+	 The residual block is kept until the next solve of another form, or a
+	 change of its size: later calls only send the changed values of J and r.
+	 The problem is resized if needed to XL.rows() variables, Aeq.rows()
+	 equalities and Aineq.rows() inequalities. nrvar(), nreq(), result() and
+	 dual_eq() only cover x and the constraints, the residuals of the
+	 solution are given by residuals().
+
+	 @param J Residual matrix, of size J.rows() x nrvar.
+	 @param r Residual offset.
+	 The other parameters are the same as in solve(), in terms of x only.
+	 */
+	EIGEN_GUROBI_API bool solveLeastSquares(const SparseMatrix<double>& J, const Ref<const VectorXd>& r,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Builds the whole model in one go, without optimizing it:
+	 calls problem() with the dimensions of the given matrices then sends all the
+	 coefficients to Gurobi, each constraint block in a single call.
+	 The model can then be solved with optimize(), and later solve() calls
+	 sharing the same sparsity pattern only update the coefficient values.
+
+	 The parameters are the same as in solve().
+	 */
+	EIGEN_GUROBI_API void loadProblem(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/**
+	 Same as loadProblem() with row-major (CSR) constraint matrices.
+	 The matrices are converted once to column-major storage.
+	 */
+	EIGEN_GUROBI_API void loadProblem(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double, RowMajor>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double, RowMajor>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/// Residuals y of the last solveLeastSquares(), empty after the other solves.
+	EIGEN_GUROBI_API const VectorXd& residuals() const;
+
+	/// Same as GurobiCommon::memoryUsage(), with the sparsity patterns.
+	EIGEN_GUROBI_API MemoryUsage memoryUsage() const;
+	/// Same as GurobiCommon::compact().
+	EIGEN_GUROBI_API void compact();
 
 private:
-	void updateConstr(GRBConstr* constrs, const std::vector<GRBVar>& vars,
+	/**
+	 Sets the number of residuals of the least squares form, 0 to remove it.
+	 The residual variables and equalities J x - y = r are created without J
+	 and r, and the objective is replaced by 1/2 y^T y.
+	 */
+	void leastSquares(int nrres);
+	void updateModel(const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	void updateObjective(const SparseMatrix<double>& Q, const SparseVector<double>& C);
+	void updateBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	/// Reads the pattern and right hand sides of a block of constraints from the model.
+	void loadPattern(const std::vector<GRBConstr>& constrs, CoeffPattern& pattern, VectorXd& bcache);
+	/**
+	 Drops the erased rows and columns from a valid pattern and renumbers the
+	 others. An empty map keeps all the rows (or columns).
+	 @param nrcol Number of columns once remapped, the new ones are empty.
+	 */
+	void remapPattern(CoeffPattern& pattern, const std::vector<int>& rowMap,
+		const std::vector<int>& colMap, int nrcol);
+	/// @param rhs Densified right hand side of the block, of size len.
+	void updateConstr(GRBConstr* constrs, CoeffPattern& pattern, VectorXd& bcache, VectorXd& rhs,
 		const Eigen::SparseMatrix<double>& A, const Eigen::SparseVector<double>& b, int len);
+	/// Sizes the densified right hand sides to the constraint blocks.
+	void resizeRhs();
+
+private:
+	CoeffPattern eqpattern_, ineqpattern_;
+	/// True if Qcache_ and C_ hold the objective of the model.
+	bool objCached_;
+	/// Last Hessian sent, compressed.
+	SparseMatrix<double> Qcache_;
+	/// Densified linear objective.
+	VectorXd linObj_;
+	/// True if XL_ and XU_ hold the bounds of the model.
+	bool boundsCached_;
+	/// Densified right hand sides of the equality and inequality blocks.
+	VectorXd rhsEq_, rhsIneq_;
+	/// Aineq without the singleton rows.
+	SparseMatrix<double> Arange_;
+	/// Residual variables of the least squares form and their equalities.
+	std::vector<GRBVar> resvars_;
+	std::vector<GRBConstr> resconstr_;
+	/// Pattern of J in the residual equalities.
+	CoeffPattern respattern_;
+	/// Right hand sides r of the residual equalities.
+	VectorXd resRhs_;
+	VectorXd residuals_;
+};
+
+
+/**
+ QP solver taking any mix of dense and sparse matrices for Q, Aeq and Aineq.
+ Each matrix goes through the update path of its storage type, chosen at
+ compile time, and is never converted to the other storage:
+ - a dense Hessian is only sent again when it changed, otherwise only the
+ changed linear coefficients are;
+ - a dense constraint block only sends the coefficients that changed, in a
+ single call;
+ - a sparse Hessian is sent as a list of nonzeros;
+ - a sparse constraint block only sends the values when its sparsity pattern
+ is unchanged.
+ The vectors are dense and only their changed entries are sent.
+ A constraint block may change of storage type between two solves, all its
+ coefficients are then sent again.
+ */
+class GurobiHybrid : public GurobiCommon
+{
+public:
+	EIGEN_GUROBI_API GurobiHybrid();
+	EIGEN_GUROBI_API GurobiHybrid(int nrvar, int nreq, int nrineq);
+	EIGEN_GUROBI_API explicit GurobiHybrid(std::shared_ptr<GRBEnv> env);
+	EIGEN_GUROBI_API GurobiHybrid(std::shared_ptr<GRBEnv> env, int nrvar, int nreq, int nrineq);
+
+	EIGEN_GUROBI_API void problem(int nrvar, int nreq, int nrineq);
+
+	/**
+	 Same as GurobiDense::solve(), Q, Aeq and Aineq being each either a
+	 MatrixXd or a SparseMatrix<double>.
+	 */
+	template<typename QMat, typename EqMat, typename IneqMat>
+	bool solve(const QMat& Q, const Ref<const VectorXd>& C,
+		const EqMat& Aeq, const Ref<const VectorXd>& Beq,
+		const IneqMat& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+	{
+		updateObjective(Q, C);
+		updateBounds(XL, XU);
+		updateConstr(eqconstr_.data(), eqblock_, Beq_, Aeq, Beq, nreq_);
+		updateConstr(ineqconstr_.data(), ineqblock_, Bineq_, Aineq, Bineq, nrineq_);
+
+		return optimize();
+	}
+
+	/// Same as GurobiDense::trySolve() for the solve() of this class.
+	template<typename QMat, typename EqMat, typename IneqMat>
+	SolveResult trySolve(const QMat& Q, const Ref<const VectorXd>& C,
+		const EqMat& Aeq, const Ref<const VectorXd>& Beq,
+		const IneqMat& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU) noexcept
+	{
+		return guardedSolve([&]() { solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU); });
+	}
+
+	/// Same as GurobiCommon::memoryUsage(), with the caches of the blocks.
+	EIGEN_GUROBI_API MemoryUsage memoryUsage() const;
+	/// Same as GurobiCommon::compact().
+	EIGEN_GUROBI_API void compact();
+
+private:
+	// The caches of the blocks are not remapped
+	using GurobiCommon::addVariables;
+	using GurobiCommon::removeVariables;
+	using GurobiCommon::addEqualities;
+	using GurobiCommon::removeEqualities;
+	using GurobiCommon::addInequalities;
+	using GurobiCommon::removeInequalities;
+
+	/// Coefficients of a block of constraints, in the storage of their last update.
+	struct ConstrBlock
+	{
+		CoeffPattern pattern;
+		MatrixXd dense;
+		/// True if dense holds the model coefficients.
+		bool denseValid;
+	};
+
+	void resetBlock(ConstrBlock& block, int len);
+	EIGEN_GUROBI_API void updateObjective(const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C);
+	EIGEN_GUROBI_API void updateObjective(const SparseMatrix<double>& Q, const Ref<const VectorXd>& C);
+	EIGEN_GUROBI_API void updateBounds(const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	EIGEN_GUROBI_API void updateConstr(GRBConstr* constrs, ConstrBlock& block, VectorXd& bcache,
+		const Ref<const MatrixXd>& A, const Ref<const VectorXd>& b, int len);
+	EIGEN_GUROBI_API void updateConstr(GRBConstr* constrs, ConstrBlock& block, VectorXd& bcache,
+		const SparseMatrix<double>& A, const Ref<const VectorXd>& b, int len);
+	void updateRhs(GRBConstr* constrs, ConstrBlock& block, VectorXd& bcache,
+		const Ref<const VectorXd>& b, int len);
+
+private:
+	ConstrBlock eqblock_, ineqblock_;
+	/// True if Q_ and C_ hold the objective of the model.
+	bool objCached_;
+	/// True if XL_ and XU_ hold the bounds of the model.
+	bool boundsCached_;
+	/// Scratch lists of the changed coefficients of a dense block.
+	std::vector<GRBConstr> coeffConstrs_;
+	std::vector<GRBVar> coeffVars_;
+	std::vector<double> coeffVals_;
 };
 
 } // namespace Eigen
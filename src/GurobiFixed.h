@@ -0,0 +1,235 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// includes
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+// eigen-gurobi
+#include "Gurobi.h"
+
+namespace Eigen
+{
+
+/**
+ Dense QP solver for problems whose size is known at compile time.
+ The data of the last solve are cached in fixed-size matrices, and only the
+ coefficients that changed since the last solve are sent to Gurobi, all the
+ constraint coefficients in a single call. The loops over the data have
+ compile-time bounds, and the results are always read one value at a time.
+ No memory is allocated by the wrapper after the construction while Q is
+ unchanged. A new Q is sent as a new objective: its terms are gathered in
+ preallocated arrays, but the Gurobi expression holding them allocates.
+ The statistics do not include the objective, bounds and constraints times.
+ @tparam NV Number of variables.
+ @tparam NEQ Number of equalities.
+ @tparam NINEQ Number of inequalities.
+ */
+template<int NV, int NEQ, int NINEQ>
+class GurobiDenseFixed : public GurobiCommon
+{
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	typedef Matrix<double, NV, NV> QMatrix;
+	typedef Matrix<double, NV, 1> VarVector;
+	typedef Matrix<double, NEQ, NV> EqMatrix;
+	typedef Matrix<double, NEQ, 1> EqVector;
+	typedef Matrix<double, NINEQ, NV> IneqMatrix;
+	typedef Matrix<double, NINEQ, 1> IneqVector;
+
+public:
+	GurobiDenseFixed():
+		GurobiDenseFixed(std::make_shared<GRBEnv>())
+	{ }
+
+	explicit GurobiDenseFixed(std::shared_ptr<GRBEnv> env):
+		GurobiCommon(std::move(env)),
+		objCached_(false),
+		dataCached_(false)
+	{
+		GurobiCommon::problem(NV, NEQ, NINEQ);
+		elementwiseAttr_ = true;
+	}
+
+	/// Same as GurobiDense::solve() with fixed-size data.
+	bool solve(const QMatrix& Q, const VarVector& C,
+		const EqMatrix& Aeq, const EqVector& Beq,
+		const IneqMatrix& Aineq, const IneqVector& Bineq,
+		const VarVector& XL, const VarVector& XU)
+	{
+		updateObjective(Q, C);
+
+		bool cached = dataCached_;
+		dataCached_ = false;
+		updateBounds(XL, XU, cached);
+		updateConstr<NEQ>(eqconstr_, Aeqc_, Beqc_, Aeq, Beq, cached);
+		updateConstr<NINEQ>(ineqconstr_, Aineqc_, Bineqc_, Aineq, Bineq, cached);
+		dataCached_ = true;
+
+		return optimize();
+	}
+
+	/// Same as GurobiDense::trySolve() with fixed-size data.
+	SolveResult trySolve(const QMatrix& Q, const VarVector& C,
+		const EqMatrix& Aeq, const EqVector& Beq,
+		const IneqMatrix& Aineq, const IneqVector& Bineq,
+		const VarVector& XL, const VarVector& XU) noexcept
+	{
+		return guardedSolve([&]() { solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU); });
+	}
+
+private:
+	// The dimensions are fixed
+	using GurobiCommon::problem;
+	using GurobiCommon::addVariables;
+	using GurobiCommon::removeVariables;
+	using GurobiCommon::addEqualities;
+	using GurobiCommon::removeEqualities;
+	using GurobiCommon::addInequalities;
+	using GurobiCommon::removeInequalities;
+
+	void updateObjective(const QMatrix& Q, const VarVector& C)
+	{
+		if (objCached_ && Q == Qc_)
+		{
+			// Only the linear coefficients that changed
+			int nrChanged = 0;
+			for(int i = 0; i < NV; ++i)
+			{
+				if (C(i) != Cc_(i))
+				{
+					objVars_[static_cast<size_t>(nrChanged)] = vars_[static_cast<size_t>(i)];
+					objVals_[static_cast<size_t>(nrChanged)] = C(i);
+					++nrChanged;
+				}
+			}
+			if (nrChanged > 0)
+			{
+				model_.set(GRB_DoubleAttr_Obj, objVars_.data(), objVals_.data(), nrChanged);
+				++stats_.apiCalls;
+				stats_.coeffsChanged += nrChanged;
+				Cc_ = C;
+			}
+			return;
+		}
+
+		// The objective is built in a single expression, of 0.5 Q
+		int nrTerms = 0;
+		for(int j = 0; j < NV; ++j)
+		{
+			for(int i = 0; i < NV; ++i)
+			{
+				if (Q(i, j) != 0.)
+				{
+					const size_t k = static_cast<size_t>(nrTerms);
+					qrowVars_[k] = vars_[static_cast<size_t>(i)];
+					qcolVars_[k] = vars_[static_cast<size_t>(j)];
+					qvals_[k] = 0.5*Q(i, j);
+					++nrTerms;
+				}
+			}
+		}
+
+		GRBQuadExpr expr;
+		expr.addTerms(qvals_.data(), qrowVars_.data(), qcolVars_.data(), nrTerms);
+		expr.addTerms(C.data(), vars_.data(), NV);
+		model_.setObjective(expr);
+		++stats_.apiCalls;
+		stats_.coeffsChanged += nrTerms + NV;
+
+		Qc_ = Q;
+		Cc_ = C;
+		objCached_ = true;
+	}
+
+	void updateBounds(const VarVector& XL, const VarVector& XU, bool cached)
+	{
+		if (!cached || XL != XLc_)
+		{
+			model_.set(GRB_DoubleAttr_LB, vars_.data(), XL.data(), NV);
+			++stats_.apiCalls;
+			XLc_ = XL;
+		}
+		if (!cached || XU != XUc_)
+		{
+			model_.set(GRB_DoubleAttr_UB, vars_.data(), XU.data(), NV);
+			++stats_.apiCalls;
+			XUc_ = XU;
+		}
+	}
+
+	template<int NR>
+	void updateConstr(std::vector<GRBConstr>& constrs,
+		Matrix<double, NR, NV>& Acache, Matrix<double, NR, 1>& bcache,
+		const Matrix<double, NR, NV>& A, const Matrix<double, NR, 1>& b, bool cached)
+	{
+		// Gather the changed coefficients, column by column
+		int nrChanged = 0;
+		for(int j = 0; j < NV; ++j)
+		{
+			for(int i = 0; i < NR; ++i)
+			{
+				if (!cached || A(i, j) != Acache(i, j))
+				{
+					const size_t k = static_cast<size_t>(nrChanged);
+					coeffConstrs_[k] = constrs[static_cast<size_t>(i)];
+					coeffVars_[k] = vars_[static_cast<size_t>(j)];
+					coeffVals_[k] = A(i, j);
+					++nrChanged;
+				}
+			}
+		}
+		if (nrChanged > 0)
+		{
+			model_.chgCoeffs(coeffConstrs_.data(), coeffVars_.data(), coeffVals_.data(), nrChanged);
+			++stats_.apiCalls;
+			stats_.coeffsChanged += nrChanged;
+			Acache = A;
+		}
+
+		if (NR > 0 && (!cached || b != bcache))
+		{
+			model_.set(GRB_DoubleAttr_RHS, constrs.data(), b.data(), NR);
+			++stats_.apiCalls;
+			bcache = b;
+		}
+	}
+
+private:
+	static constexpr int maxRows = NEQ > NINEQ ? NEQ : NINEQ;
+
+	bool objCached_, dataCached_;
+	QMatrix Qc_;
+	VarVector Cc_, XLc_, XUc_;
+	EqMatrix Aeqc_;
+	EqVector Beqc_;
+	IneqMatrix Aineqc_;
+	IneqVector Bineqc_;
+
+	std::array<GRBVar, NV> objVars_;
+	std::array<double, NV> objVals_;
+	std::array<GRBVar, NV*NV> qrowVars_, qcolVars_;
+	std::array<double, NV*NV> qvals_;
+	std::array<GRBConstr, NV*maxRows> coeffConstrs_;
+	std::array<GRBVar, NV*maxRows> coeffVars_;
+	std::array<double, NV*maxRows> coeffVals_;
+};
+
+} // namespace Eigen
@@ -0,0 +1,191 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+// associated header
+#include "GurobiPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace
+{
+
+/// Runs the job i on the solver i % nrWorkers, solvers holding at least
+/// min(nrWorkers, nrProblems) solvers.
+template<typename Solver>
+std::vector<int> runBatch(int nrProblems, int nrWorkers, std::vector<std::unique_ptr<Solver>>& solvers,
+	const std::function<void(int, Solver&)>& job)
+{
+	std::vector<int> status(static_cast<size_t>(std::max(nrProblems, 0)), 0);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto work = [&](int w) {
+		Solver& qp = *solvers[static_cast<size_t>(w)];
+		for(int i = w; i < nrProblems; i += nrWorkers)
+		{
+			try
+			{
+				job(i, qp);
+				status[static_cast<size_t>(i)] = qp.status();
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	const int nrThreads = std::min(nrWorkers, nrProblems);
+	assert(static_cast<int>(solvers.size()) >= nrThreads);
+	std::vector<std::thread> threads;
+	threads.reserve(static_cast<size_t>(std::max(nrThreads - 1, 0)));
+	for(int t = 1; t < nrThreads; ++t)
+	{
+		threads.emplace_back(work, t);
+	}
+	// The calling thread is the first worker
+	if (nrThreads > 0)
+	{
+		work(0);
+	}
+	for(std::thread& th : threads)
+	{
+		th.join();
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return status;
+}
+
+} // namespace
+
+namespace Eigen
+{
+
+
+GurobiSolverPool::GurobiSolverPool(int nrWorkers, int threadsPerModel):
+	GurobiSolverPool(std::make_shared<GRBEnv>(), nrWorkers, threadsPerModel)
+{ }
+
+
+GurobiSolverPool::GurobiSolverPool(std::shared_ptr<GRBEnv> env, int nrWorkers, int threadsPerModel):
+	env_(std::move(env)),
+	nrWorkers_(nrWorkers > 0 ? nrWorkers : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1)),
+	threadsPerModel_(threadsPerModel),
+	envMutex_(),
+	dense_(),
+	sparse_()
+{
+	assert(threadsPerModel >= 0);
+}
+
+
+const std::shared_ptr<GRBEnv>& GurobiSolverPool::env() const
+{
+	return env_;
+}
+
+
+int GurobiSolverPool::nrWorkers() const
+{
+	return nrWorkers_;
+}
+
+
+int GurobiSolverPool::threadsPerModel() const
+{
+	return threadsPerModel_;
+}
+
+
+std::unique_ptr<GurobiDense> GurobiSolverPool::makeDense()
+{
+	std::unique_ptr<GurobiDense> qp(new GurobiDense(copyEnv()));
+	qp->threads(threadsPerModel_);
+	return qp;
+}
+
+
+std::unique_ptr<GurobiSparse> GurobiSolverPool::makeSparse()
+{
+	std::unique_ptr<GurobiSparse> qp(new GurobiSparse(copyEnv()));
+	qp->threads(threadsPerModel_);
+	return qp;
+}
+
+
+std::shared_ptr<GRBEnv> GurobiSolverPool::copyEnv()
+{
+	// The C++ API has no parameters copy: they go through a parameter file,
+	// read before the new environment is started so that the license
+	// settings apply
+	const std::string path = std::string(std::tmpnam(nullptr)) + ".prm";
+	std::shared_ptr<GRBEnv> env = std::make_shared<GRBEnv>(true);
+	try
+	{
+		{
+			std::lock_guard<std::mutex> lock(envMutex_);
+			env_->writeParams(path);
+		}
+		env->readParams(path);
+		env->start();
+	}
+	catch(...)
+	{
+		std::remove(path.c_str());
+		throw;
+	}
+	std::remove(path.c_str());
+	return env;
+}
+
+
+std::vector<int> GurobiSolverPool::solveDenseBatch(int nrProblems, const DenseJob& job)
+{
+	while (static_cast<int>(dense_.size()) < std::min(nrWorkers_, nrProblems))
+	{
+		std::unique_ptr<GurobiDense> qp(new GurobiDense(copyEnv()));
+		qp->threads(threadsPerModel_);
+		dense_.push_back(std::move(qp));
+	}
+	return runBatch(nrProblems, nrWorkers_, dense_, job);
+}
+
+
+std::vector<int> GurobiSolverPool::solveSparseBatch(int nrProblems, const SparseJob& job)
+{
+	while (static_cast<int>(sparse_.size()) < std::min(nrWorkers_, nrProblems))
+	{
+		std::unique_ptr<GurobiSparse> qp(new GurobiSparse(copyEnv()));
+		qp->threads(threadsPerModel_);
+		sparse_.push_back(std::move(qp));
+	}
+	return runBatch(nrProblems, nrWorkers_, sparse_, job);
+}
+
+} // namespace Eigen
@@ -0,0 +1,108 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// includes
+// std
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// eigen-gurobi
+#include "Gurobi.h"
+#include "eigen_gurobi_api.h"
+
+namespace Eigen
+{
+
+/**
+ Pool of solvers used to solve batches of independent QPs in parallel.
+ Gurobi environments are not thread safe, and the models of an environment
+ cannot be solved concurrently: every solver of the pool has its own
+ environment, created with a copy of the parameters of env() (license, WLS or
+ compute server settings, OutputFlag...). Each environment costs one license
+ checkout. Each worker thread owns one GurobiDense and one GurobiSparse solver,
+ created on first use, and the solvers are kept between batches.
+ The jobs are statically assigned: worker w runs the jobs w, w + nrWorkers(),
+ w + 2 nrWorkers()... in that order, so a job starts from the model (and warm
+ start information) of the previous job of its worker, and with at most
+ nrWorkers() jobs per batch, job i reuses its own model from one batch to the
+ next.
+ A pool runs one batch at a time.
+ */
+class GurobiSolverPool
+{
+public:
+	using DenseJob = std::function<void(int index, GurobiDense& qp)>;
+	using SparseJob = std::function<void(int index, GurobiSparse& qp)>;
+
+public:
+	/**
+	 @param nrWorkers Number of worker threads, 0 for the number of hardware threads.
+	 @param threadsPerModel Gurobi Threads parameter of each solver of the pool.
+	 */
+	EIGEN_GUROBI_API explicit GurobiSolverPool(int nrWorkers = 0, int threadsPerModel = 1);
+	EIGEN_GUROBI_API GurobiSolverPool(std::shared_ptr<GRBEnv> env, int nrWorkers = 0, int threadsPerModel = 1);
+
+	/**
+	 Environment whose parameters are copied to the environments of the
+	 solvers, when they are created. No model is solved in it.
+	 */
+	EIGEN_GUROBI_API const std::shared_ptr<GRBEnv>& env() const;
+	EIGEN_GUROBI_API int nrWorkers() const;
+	EIGEN_GUROBI_API int threadsPerModel() const;
+
+	/**
+	 Creates a new solver with its own environment, a copy of env(), and the
+	 pool Threads parameter. Can be called from any thread, and the solvers
+	 can be used concurrently. Costs one license checkout per solver.
+	 */
+	EIGEN_GUROBI_API std::unique_ptr<GurobiDense> makeDense();
+	/// Same as makeDense() for a sparse solver.
+	EIGEN_GUROBI_API std::unique_ptr<GurobiSparse> makeSparse();
+
+	/**
+	 Calls job(i, qp) for every i in [0, nrProblems), on the worker
+	 i % nrWorkers(). qp is the dense solver of that worker: the job
+	 is expected to set up its problem (problem() if the dimensions change)
+	 and solve it, and to copy the result it needs.
+	 If a job throws, the remaining jobs are still run and the first exception
+	 is rethrown once all the workers are done.
+
+	 @param nrProblems Number of jobs.
+	 @param job Function setting up and solving the i-th problem.
+	 @return Status of the solver of each job once it returned.
+	 */
+	EIGEN_GUROBI_API std::vector<int> solveDenseBatch(int nrProblems, const DenseJob& job);
+	/// Same as solveDenseBatch() with the sparse solvers of the workers.
+	EIGEN_GUROBI_API std::vector<int> solveSparseBatch(int nrProblems, const SparseJob& job);
+
+private:
+	/// New environment with the parameters of env_.
+	std::shared_ptr<GRBEnv> copyEnv();
+
+private:
+	std::shared_ptr<GRBEnv> env_;
+	int nrWorkers_, threadsPerModel_;
+	/// Gurobi environments are not thread safe: protects the parameters copy
+	/// from env_.
+	std::mutex envMutex_;
+	std::vector<std::unique_ptr<GurobiDense>> dense_;
+	std::vector<std::unique_ptr<GurobiSparse>> sparse_;
+};
+
+} // namespace Eigen
@@ -0,0 +1,701 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+// associated header
+#include "GurobiRecorder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+
+// Layout of a log:
+//  - FileHeader,
+//  - for each record: RecordHeader, ParameterRecord if the parameters changed,
+//    and one BlockHeader followed by its arrays for each of the NR_BLOCKS blocks.
+// Every array starts on 8 bytes.
+
+const char logMagic[8] = {'E', 'G', 'Q', 'P', 'L', 'O', 'G', '\0'};
+const std::uint32_t logVersion = 1;
+const std::uint32_t logByteOrder = 0x01020304;
+
+struct FileHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byteOrder;
+};
+
+/// The record holds a ParameterRecord.
+const std::uint32_t HAS_PARAMETERS = 1;
+
+struct RecordHeader
+{
+	std::uint32_t kind;
+	std::uint32_t flags;
+	std::int32_t nrvar, nreq, nrineq, unused;
+	/// Size of the record, this header included.
+	std::uint64_t size;
+};
+
+struct ParameterRecord
+{
+	std::int32_t method, threads, presolve, crossover, scaleFlag, numericFocus, warmStart, unused;
+	double barrierConvergenceTolerance, feasibilityTolerance, optimalityTolerance;
+	double timeLimit, iterationLimit;
+};
+
+enum Encoding : std::int32_t
+{
+	/// Same as in the previous record of the same kind.
+	SAME = 0,
+	/// rows*cols column major values.
+	FULL = 1,
+	/// count indices in the values of the previous record, then their count values.
+	DELTA = 2,
+	/// Compressed column storage: cols + 1 outer indices, then count inner indices and values.
+	COMPRESSED = 3
+};
+
+struct BlockHeader
+{
+	std::int32_t encoding, rows, cols, count;
+};
+
+std::size_t padded(std::size_t size)
+{
+	return (size + 7) & ~static_cast<std::size_t>(7);
+}
+
+void append(std::vector<char>& buffer, const void* src, std::size_t size)
+{
+	const char* bytes = static_cast<const char*>(src);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+	buffer.resize(padded(buffer.size()), '\0');
+}
+
+void appendHeader(std::vector<char>& buffer, Encoding encoding, int rows, int cols, int count)
+{
+	BlockHeader header = {encoding, rows, cols, count};
+	append(buffer, &header, sizeof(header));
+}
+
+template<typename Solver>
+void setupSolver(Solver& qp, int nrvar, int nreq, int nrineq,
+	const Eigen::GurobiRecorder::Parameters& params, bool applyParameters)
+{
+	if (qp.nrvar() != nrvar || qp.nreq() != nreq || qp.nrineq() != nrineq)
+	{
+		qp.problem(nrvar, nreq, nrineq);
+	}
+	if (applyParameters)
+	{
+		qp.parameters(params.solver);
+		qp.timeLimit(params.timeLimit);
+		qp.iterationLimit(params.iterationLimit);
+		if (qp.warmStart() != params.warmStart)
+		{
+			qp.warmStart(params.warmStart);
+		}
+	}
+}
+
+} // namespace
+
+namespace Eigen
+{
+
+
+/**
+	*													GurobiRecorder
+	*/
+
+
+GurobiRecorder::Block::Block():
+	rows(-1),
+	cols(-1),
+	outer(),
+	inner(),
+	values()
+{ }
+
+
+GurobiRecorder::GurobiRecorder(const std::string& path):
+	file_(path, std::ios::binary | std::ios::trunc),
+	nrRecords_(0),
+	bytesWritten_(0),
+	buffer_(),
+	dense_(),
+	sparse_(),
+	hasParameters_(false),
+	parameters_(),
+	vector_(),
+	compressed_(),
+	changed_()
+{
+	if (!file_)
+	{
+		throw "cannot open the solve log";
+	}
+
+	FileHeader header;
+	std::memcpy(header.magic, logMagic, sizeof(logMagic));
+	header.version = logVersion;
+	header.byteOrder = logByteOrder;
+	file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	bytesWritten_ = sizeof(header);
+}
+
+
+void GurobiRecorder::record(const GurobiCommon& qp,
+	const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+	const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+	const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	begin(DENSE, qp);
+	writeDense(dense_[BLOCK_Q], Q);
+	writeDense(dense_[BLOCK_C], C);
+	writeDense(dense_[BLOCK_AEQ], Aeq);
+	writeDense(dense_[BLOCK_BEQ], Beq);
+	writeDense(dense_[BLOCK_AINEQ], Aineq);
+	writeDense(dense_[BLOCK_BINEQ], Bineq);
+	writeDense(dense_[BLOCK_XL], XL);
+	writeDense(dense_[BLOCK_XU], XU);
+	end();
+}
+
+
+void GurobiRecorder::record(const GurobiCommon& qp,
+	const SparseMatrix<double>& Q, const SparseVector<double>& C,
+	const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+	const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+	const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU)
+{
+	begin(SPARSE, qp);
+	writeSparse(sparse_[BLOCK_Q], Q);
+	vector_ = C;
+	writeSparse(sparse_[BLOCK_C], vector_);
+	writeSparse(sparse_[BLOCK_AEQ], Aeq);
+	vector_ = Beq;
+	writeSparse(sparse_[BLOCK_BEQ], vector_);
+	writeSparse(sparse_[BLOCK_AINEQ], Aineq);
+	vector_ = Bineq;
+	writeSparse(sparse_[BLOCK_BINEQ], vector_);
+	writeDense(sparse_[BLOCK_XL], XL);
+	writeDense(sparse_[BLOCK_XU], XU);
+	end();
+}
+
+
+void GurobiRecorder::flush()
+{
+	file_.flush();
+}
+
+
+int GurobiRecorder::nrRecords() const
+{
+	return nrRecords_;
+}
+
+
+std::size_t GurobiRecorder::bytesWritten() const
+{
+	return bytesWritten_;
+}
+
+
+void GurobiRecorder::begin(Kind kind, const GurobiCommon& qp)
+{
+	Parameters params;
+	params.solver = qp.parameters();
+	params.timeLimit = qp.timeLimit();
+	params.iterationLimit = qp.iterationLimit();
+	params.warmStart = qp.warmStart();
+
+	const GurobiCommon::SolverParameters& s = params.solver;
+	const GurobiCommon::SolverParameters& l = parameters_.solver;
+	bool changed = !hasParameters_ || s.method != l.method || s.threads != l.threads
+		|| s.presolve != l.presolve || s.crossover != l.crossover
+		|| s.barrierConvergenceTolerance != l.barrierConvergenceTolerance
+		|| s.scaleFlag != l.scaleFlag || s.numericFocus != l.numericFocus
+		|| s.feasibilityTolerance != l.feasibilityTolerance
+		|| s.optimalityTolerance != l.optimalityTolerance
+		|| params.timeLimit != parameters_.timeLimit
+		|| params.iterationLimit != parameters_.iterationLimit
+		|| params.warmStart != parameters_.warmStart;
+
+	buffer_.clear();
+	RecordHeader header = {kind, changed ? HAS_PARAMETERS : 0, qp.nrvar(), qp.nreq(), qp.nrineq(), 0, 0};
+	append(buffer_, &header, sizeof(header));
+	if (changed)
+	{
+		ParameterRecord p = {
+			static_cast<std::int32_t>(s.method), s.threads, static_cast<std::int32_t>(s.presolve),
+			s.crossover, s.scaleFlag, s.numericFocus, static_cast<std::int32_t>(params.warmStart), 0,
+			s.barrierConvergenceTolerance, s.feasibilityTolerance, s.optimalityTolerance,
+			params.timeLimit, params.iterationLimit};
+		append(buffer_, &p, sizeof(p));
+		parameters_ = params;
+		hasParameters_ = true;
+	}
+}
+
+
+void GurobiRecorder::writeDense(Block& last, const Ref<const MatrixXd>& M)
+{
+	const int rows = static_cast<int>(M.rows());
+	const int cols = static_cast<int>(M.cols());
+	const std::size_t size = static_cast<std::size_t>(rows)*static_cast<std::size_t>(cols);
+
+	if (!last.outer.empty() || last.rows != rows || last.cols != cols)
+	{
+		appendHeader(buffer_, FULL, rows, cols, 0);
+		last.rows = rows;
+		last.cols = cols;
+		last.outer.clear();
+		last.inner.clear();
+		last.values.resize(size);
+		for(int j = 0; j < cols; ++j)
+		{
+			std::copy_n(M.col(j).data(), rows, last.values.data() + static_cast<std::size_t>(j)*rows);
+		}
+		append(buffer_, last.values.data(), size*sizeof(double));
+		return;
+	}
+
+	changed_.clear();
+	for(int j = 0; j < cols; ++j)
+	{
+		const double* col = M.col(j).data();
+		const double* lastCol = last.values.data() + static_cast<std::size_t>(j)*rows;
+		for(int i = 0; i < rows; ++i)
+		{
+			if (col[i] != lastCol[i])
+			{
+				changed_.push_back(j*rows + i);
+			}
+		}
+	}
+
+	// A delta costs an index and a value per coefficient
+	if (changed_.empty() || changed_.size()*(sizeof(int) + sizeof(double)) < size*sizeof(double))
+	{
+		for(int k : changed_)
+		{
+			last.values[static_cast<std::size_t>(k)] = M(k % rows, k/rows);
+		}
+		writeValues(last, nullptr);
+		return;
+	}
+
+	appendHeader(buffer_, FULL, rows, cols, 0);
+	for(int j = 0; j < cols; ++j)
+	{
+		std::copy_n(M.col(j).data(), rows, last.values.data() + static_cast<std::size_t>(j)*rows);
+	}
+	append(buffer_, last.values.data(), size*sizeof(double));
+}
+
+
+void GurobiRecorder::writeSparse(Block& last, const SparseMatrix<double>& M)
+{
+	if (!M.isCompressed())
+	{
+		compressed_ = M;
+		compressed_.makeCompressed();
+		writeSparse(last, compressed_);
+		return;
+	}
+
+	const int rows = static_cast<int>(M.rows());
+	const int cols = static_cast<int>(M.cols());
+	const int nnz = static_cast<int>(M.nonZeros());
+	const std::size_t nrOuter = static_cast<std::size_t>(cols) + 1;
+
+	bool samePattern = last.rows == rows && last.cols == cols
+		&& last.outer.size() == nrOuter && last.inner.size() == static_cast<std::size_t>(nnz)
+		&& std::equal(last.outer.begin(), last.outer.end(), M.outerIndexPtr())
+		&& std::equal(last.inner.begin(), last.inner.end(), M.innerIndexPtr());
+	if (samePattern)
+	{
+		writeValues(last, M.valuePtr());
+		return;
+	}
+
+	appendHeader(buffer_, COMPRESSED, rows, cols, nnz);
+	last.rows = rows;
+	last.cols = cols;
+	last.outer.assign(M.outerIndexPtr(), M.outerIndexPtr() + nrOuter);
+	last.inner.assign(M.innerIndexPtr(), M.innerIndexPtr() + nnz);
+	last.values.assign(M.valuePtr(), M.valuePtr() + nnz);
+	append(buffer_, last.outer.data(), nrOuter*sizeof(int));
+	append(buffer_, last.inner.data(), last.inner.size()*sizeof(int));
+	append(buffer_, last.values.data(), last.values.size()*sizeof(double));
+}
+
+
+void GurobiRecorder::writeValues(Block& last, const double* values)
+{
+	// values is null when changed_ and last are already up to date
+	if (values != nullptr)
+	{
+		changed_.clear();
+		for(std::size_t k = 0; k < last.values.size(); ++k)
+		{
+			if (values[k] != last.values[k])
+			{
+				changed_.push_back(static_cast<int>(k));
+				last.values[k] = values[k];
+			}
+		}
+	}
+
+	if (changed_.empty())
+	{
+		appendHeader(buffer_, SAME, last.rows, last.cols, 0);
+		return;
+	}
+
+	const int count = static_cast<int>(changed_.size());
+	appendHeader(buffer_, DELTA, last.rows, last.cols, count);
+	append(buffer_, changed_.data(), changed_.size()*sizeof(int));
+	const std::size_t start = buffer_.size();
+	buffer_.resize(start + changed_.size()*sizeof(double));
+	for(std::size_t k = 0; k < changed_.size(); ++k)
+	{
+		std::memcpy(buffer_.data() + start + k*sizeof(double),
+			&last.values[static_cast<std::size_t>(changed_[k])], sizeof(double));
+	}
+}
+
+
+void GurobiRecorder::end()
+{
+	const std::uint64_t size = buffer_.size();
+	std::memcpy(buffer_.data() + offsetof(RecordHeader, size), &size, sizeof(size));
+	file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+	if (!file_)
+	{
+		throw "cannot write the solve log";
+	}
+	bytesWritten_ += buffer_.size();
+	++nrRecords_;
+}
+
+
+/**
+	*													GurobiReplay
+	*/
+
+
+GurobiReplay::GurobiReplay(const std::string& path):
+	data_(),
+	pos_(0),
+	kind_(GurobiRecorder::DENSE),
+	nrvar_(0),
+	nreq_(0),
+	nrineq_(0),
+	parameters_(),
+	dense_(),
+	sparse_(),
+	Q_(),
+	Aeq_(),
+	Aineq_(),
+	C_(),
+	Beq_(),
+	Bineq_()
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		throw "cannot open the solve log";
+	}
+	data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	FileHeader header;
+	if (data_.size() < sizeof(header))
+	{
+		throw "not a solve log";
+	}
+	std::memcpy(&header, data_.data(), sizeof(header));
+	if (std::memcmp(header.magic, logMagic, sizeof(logMagic)) != 0
+		|| header.version != logVersion || header.byteOrder != logByteOrder)
+	{
+		throw "not a solve log, or written by another version or machine";
+	}
+	rewind();
+}
+
+
+bool GurobiReplay::next()
+{
+	if (pos_ >= data_.size())
+	{
+		return false;
+	}
+
+	const std::size_t start = pos_;
+	RecordHeader header;
+	read(&header, sizeof(header));
+	if (header.size > data_.size() - start)
+	{
+		throw "truncated solve log";
+	}
+
+	kind_ = static_cast<GurobiRecorder::Kind>(header.kind);
+	nrvar_ = header.nrvar;
+	nreq_ = header.nreq;
+	nrineq_ = header.nrineq;
+
+	if (header.flags & HAS_PARAMETERS)
+	{
+		ParameterRecord p;
+		read(&p, sizeof(p));
+		GurobiCommon::SolverParameters& s = parameters_.solver;
+		s.method = static_cast<GurobiCommon::Method>(p.method);
+		s.threads = p.threads;
+		s.presolve = static_cast<GurobiCommon::Presolve>(p.presolve);
+		s.crossover = p.crossover;
+		s.scaleFlag = p.scaleFlag;
+		s.numericFocus = p.numericFocus;
+		s.barrierConvergenceTolerance = p.barrierConvergenceTolerance;
+		s.feasibilityTolerance = p.feasibilityTolerance;
+		s.optimalityTolerance = p.optimalityTolerance;
+		parameters_.timeLimit = p.timeLimit;
+		parameters_.iterationLimit = p.iterationLimit;
+		parameters_.warmStart = static_cast<GurobiCommon::WarmStatus>(p.warmStart);
+	}
+
+	if (kind_ == GurobiRecorder::DENSE)
+	{
+		for(GurobiRecorder::Block& block : dense_)
+		{
+			readDense(block);
+		}
+	}
+	else if (kind_ == GurobiRecorder::SPARSE)
+	{
+		auto toMatrix = [](const GurobiRecorder::Block& block, SparseMatrix<double>& M) {
+			M = Map<const SparseMatrix<double>>(block.rows, block.cols, static_cast<Index>(block.values.size()),
+				block.outer.data(), block.inner.data(), block.values.data());
+		};
+		auto toVector = [](const GurobiRecorder::Block& block, SparseVector<double>& v) {
+			v.resize(block.rows);
+			v.reserve(static_cast<Index>(block.values.size()));
+			for(std::size_t k = 0; k < block.values.size(); ++k)
+			{
+				v.insertBack(block.inner[k]) = block.values[k];
+			}
+		};
+
+		using B = GurobiRecorder::BlockIndex;
+		if (readSparse(sparse_[B::BLOCK_Q])) toMatrix(sparse_[B::BLOCK_Q], Q_);
+		if (readSparse(sparse_[B::BLOCK_C])) toVector(sparse_[B::BLOCK_C], C_);
+		if (readSparse(sparse_[B::BLOCK_AEQ])) toMatrix(sparse_[B::BLOCK_AEQ], Aeq_);
+		if (readSparse(sparse_[B::BLOCK_BEQ])) toVector(sparse_[B::BLOCK_BEQ], Beq_);
+		if (readSparse(sparse_[B::BLOCK_AINEQ])) toMatrix(sparse_[B::BLOCK_AINEQ], Aineq_);
+		if (readSparse(sparse_[B::BLOCK_BINEQ])) toVector(sparse_[B::BLOCK_BINEQ], Bineq_);
+		readDense(sparse_[B::BLOCK_XL]);
+		readDense(sparse_[B::BLOCK_XU]);
+	}
+	else
+	{
+		throw "unknown record in the solve log";
+	}
+
+	pos_ = start + header.size;
+	return true;
+}
+
+
+void GurobiReplay::rewind()
+{
+	pos_ = sizeof(FileHeader);
+	for(GurobiRecorder::Block& block : dense_)
+	{
+		block = GurobiRecorder::Block();
+	}
+	for(GurobiRecorder::Block& block : sparse_)
+	{
+		block = GurobiRecorder::Block();
+	}
+}
+
+
+GurobiRecorder::Kind GurobiReplay::kind() const
+{
+	return kind_;
+}
+
+
+int GurobiReplay::nrvar() const
+{
+	return nrvar_;
+}
+
+
+int GurobiReplay::nreq() const
+{
+	return nreq_;
+}
+
+
+int GurobiReplay::nrineq() const
+{
+	return nrineq_;
+}
+
+
+const GurobiRecorder::Parameters& GurobiReplay::parameters() const
+{
+	return parameters_;
+}
+
+
+void GurobiReplay::setup(GurobiDense& qp, bool applyParameters) const
+{
+	setupSolver(qp, nrvar_, nreq_, nrineq_, parameters_, applyParameters);
+}
+
+
+void GurobiReplay::setup(GurobiSparse& qp, bool applyParameters) const
+{
+	setupSolver(qp, nrvar_, nreq_, nrineq_, parameters_, applyParameters);
+}
+
+
+bool GurobiReplay::solve(GurobiDense& qp) const
+{
+	assert(kind_ == GurobiRecorder::DENSE);
+
+	auto matrix = [this](GurobiRecorder::BlockIndex b) {
+		const GurobiRecorder::Block& block = dense_[b];
+		return Map<const MatrixXd>(block.values.data(), block.rows, block.cols);
+	};
+	auto vector = [this](GurobiRecorder::BlockIndex b) {
+		const GurobiRecorder::Block& block = dense_[b];
+		return Map<const VectorXd>(block.values.data(), block.rows);
+	};
+
+	return qp.solve(matrix(GurobiRecorder::BLOCK_Q), vector(GurobiRecorder::BLOCK_C),
+		matrix(GurobiRecorder::BLOCK_AEQ), vector(GurobiRecorder::BLOCK_BEQ),
+		matrix(GurobiRecorder::BLOCK_AINEQ), vector(GurobiRecorder::BLOCK_BINEQ),
+		vector(GurobiRecorder::BLOCK_XL), vector(GurobiRecorder::BLOCK_XU));
+}
+
+
+bool GurobiReplay::solve(GurobiSparse& qp) const
+{
+	assert(kind_ == GurobiRecorder::SPARSE);
+
+	auto vector = [this](GurobiRecorder::BlockIndex b) {
+		const GurobiRecorder::Block& block = sparse_[b];
+		return Map<const VectorXd>(block.values.data(), block.rows);
+	};
+
+	return qp.solve(Q_, C_, Aeq_, Beq_, Aineq_, Bineq_,
+		vector(GurobiRecorder::BLOCK_XL), vector(GurobiRecorder::BLOCK_XU));
+}
+
+
+void GurobiReplay::read(void* dst, std::size_t size)
+{
+	std::memcpy(dst, at(pos_, size), size);
+	pos_ = padded(pos_ + size);
+}
+
+
+const char* GurobiReplay::at(std::size_t pos, std::size_t size) const
+{
+	if (pos > data_.size() || size > data_.size() - pos)
+	{
+		throw "truncated solve log";
+	}
+	return data_.data() + pos;
+}
+
+
+void GurobiReplay::readDense(GurobiRecorder::Block& block)
+{
+	BlockHeader header;
+	read(&header, sizeof(header));
+	const std::size_t size = static_cast<std::size_t>(header.rows)*static_cast<std::size_t>(header.cols);
+	const std::size_t count = static_cast<std::size_t>(header.count);
+
+	switch (header.encoding)
+	{
+		case SAME:
+			break;
+		case FULL:
+			block.rows = header.rows;
+			block.cols = header.cols;
+			block.values.resize(size);
+			read(block.values.data(), size*sizeof(double));
+			break;
+		case DELTA:
+		{
+			const char* indices = at(pos_, count*sizeof(int));
+			const char* values = at(padded(pos_ + count*sizeof(int)), count*sizeof(double));
+			for(std::size_t k = 0; k < count; ++k)
+			{
+				int index;
+				std::memcpy(&index, indices + k*sizeof(int), sizeof(int));
+				if (index < 0 || static_cast<std::size_t>(index) >= block.values.size())
+				{
+					throw "corrupted solve log";
+				}
+				std::memcpy(&block.values[static_cast<std::size_t>(index)], values + k*sizeof(double), sizeof(double));
+			}
+			pos_ = padded(pos_ + count*sizeof(int)) + padded(count*sizeof(double));
+			break;
+		}
+		default:
+			throw "corrupted solve log";
+	}
+}
+
+
+bool GurobiReplay::readSparse(GurobiRecorder::Block& block)
+{
+	const std::size_t start = pos_;
+	BlockHeader header;
+	read(&header, sizeof(header));
+
+	if (header.encoding == COMPRESSED)
+	{
+		const std::size_t nnz = static_cast<std::size_t>(header.count);
+		block.rows = header.rows;
+		block.cols = header.cols;
+		block.outer.resize(static_cast<std::size_t>(header.cols) + 1);
+		block.inner.resize(nnz);
+		block.values.resize(nnz);
+		read(block.outer.data(), block.outer.size()*sizeof(int));
+		read(block.inner.data(), nnz*sizeof(int));
+		read(block.values.data(), nnz*sizeof(double));
+		return true;
+	}
+
+	// The values of a known pattern are read as a dense block
+	pos_ = start;
+	readDense(block);
+	return header.encoding != SAME;
+}
+
+} // namespace Eigen
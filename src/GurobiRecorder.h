@@ -0,0 +1,209 @@
+// This file is part of EigenQP.
+//
+// EigenQP is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EigenQP is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with EigenQP.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// includes
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Eigen
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+// eigen-gurobi
+#include "Gurobi.h"
+#include "eigen_gurobi_api.h"
+
+namespace Eigen
+{
+
+/**
+ Appends the inputs of successive solves (data, dimensions and solver
+ parameters) to a binary log, to replay them offline with GurobiReplay.
+ A recorder is attached to a solver with GurobiCommon::recorder(), and then
+ records every GurobiDense and GurobiSparse solve taking the whole problem
+ (solve(), solveAsync() and each instance of solveParametric()), before the
+ data are sent to Gurobi. The entry points that cannot be replayed throw
+ while the recorder is attached, see GurobiCommon::recorder().
+
+ Each record only holds the blocks that changed since the previous record of
+ the same kind: an unchanged block costs a few bytes, a block with a few
+ changed coefficients only holds those, and the sparse blocks keep their
+ compressed storage. All the arrays are 8 bytes aligned in the file, so a log
+ can also be memory mapped. The log is in the byte order of the machine.
+
+ The deltas are taken against the previous record of the same kind: a
+ recorder should be attached to at most one dense and one sparse solver.
+ */
+class GurobiRecorder
+{
+public:
+	/// Solver of a record.
+	enum Kind : std::uint32_t
+	{
+		DENSE = 1,
+		SPARSE = 2
+	};
+
+public:
+	/**
+	 Creates the log, or truncates an existing file.
+	 Throws if the file cannot be opened.
+	 */
+	EIGEN_GUROBI_API explicit GurobiRecorder(const std::string& path);
+
+	/// Appends a GurobiDense::solve() call of qp.
+	EIGEN_GUROBI_API void record(const GurobiCommon& qp,
+		const Ref<const MatrixXd>& Q, const Ref<const VectorXd>& C,
+		const Ref<const MatrixXd>& Aeq, const Ref<const VectorXd>& Beq,
+		const Ref<const MatrixXd>& Aineq, const Ref<const VectorXd>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+	/// Appends a GurobiSparse::solve() call of qp.
+	EIGEN_GUROBI_API void record(const GurobiCommon& qp,
+		const SparseMatrix<double>& Q, const SparseVector<double>& C,
+		const SparseMatrix<double>& Aeq, const SparseVector<double>& Beq,
+		const SparseMatrix<double>& Aineq, const SparseVector<double>& Bineq,
+		const Ref<const VectorXd>& XL, const Ref<const VectorXd>& XU);
+
+	/// Writes the buffered records to the file.
+	EIGEN_GUROBI_API void flush();
+
+	EIGEN_GUROBI_API int nrRecords() const;
+	/// Size of the log, header included.
+	EIGEN_GUROBI_API std::size_t bytesWritten() const;
+
+	/// Solver parameters of a record.
+	struct Parameters
+	{
+		GurobiCommon::SolverParameters solver;
+		double timeLimit;
+		double iterationLimit;
+		GurobiCommon::WarmStatus warmStart;
+	};
+
+private:
+	friend class GurobiReplay;
+
+	/// Last values of a matrix or vector, dense when outer is empty.
+	struct Block
+	{
+		Block();
+
+		int rows, cols;
+		std::vector<int> outer, inner;
+		std::vector<double> values;
+	};
+
+	/// Index of the blocks in a record.
+	enum BlockIndex
+	{
+		BLOCK_Q, BLOCK_C, BLOCK_AEQ, BLOCK_BEQ, BLOCK_AINEQ, BLOCK_BINEQ, BLOCK_XL, BLOCK_XU,
+		NR_BLOCKS
+	};
+
+private:
+	void begin(Kind kind, const GurobiCommon& qp);
+	void writeDense(Block& last, const Ref<const MatrixXd>& M);
+	void writeSparse(Block& last, const SparseMatrix<double>& M);
+	void writeValues(Block& last, const double* values);
+	void end();
+
+private:
+	std::ofstream file_;
+	int nrRecords_;
+	std::size_t bytesWritten_;
+	/// Record being written.
+	std::vector<char> buffer_;
+	std::array<Block, NR_BLOCKS> dense_, sparse_;
+	bool hasParameters_;
+	Parameters parameters_;
+	/// Sparse vectors, in compressed column storage.
+	SparseMatrix<double> vector_;
+	/// Compressed copy of the sparse data that are not compressed.
+	SparseMatrix<double> compressed_;
+	/// Changed coefficients of a block.
+	std::vector<int> changed_;
+};
+
+
+/**
+ Reads back a log written by GurobiRecorder, one record at a time, to re-run
+ the solves.
+ */
+class GurobiReplay
+{
+public:
+	/**
+	 Loads the log. Throws if the file cannot be read or is not a log.
+	 */
+	EIGEN_GUROBI_API explicit GurobiReplay(const std::string& path);
+
+	/**
+	 Decodes the next record.
+	 @return false at the end of the log.
+	 */
+	EIGEN_GUROBI_API bool next();
+	/// Goes back to the first record.
+	EIGEN_GUROBI_API void rewind();
+
+	/// Solver of the current record.
+	EIGEN_GUROBI_API GurobiRecorder::Kind kind() const;
+	EIGEN_GUROBI_API int nrvar() const;
+	EIGEN_GUROBI_API int nreq() const;
+	EIGEN_GUROBI_API int nrineq() const;
+	/// Solver parameters of the current record.
+	EIGEN_GUROBI_API const GurobiRecorder::Parameters& parameters() const;
+
+	/**
+	 Prepares qp to solve the current record: calls problem() when the
+	 dimensions of qp are not the ones of the record, and applies the recorded
+	 parameters if applyParameters is true.
+	 */
+	EIGEN_GUROBI_API void setup(GurobiDense& qp, bool applyParameters = true) const;
+	/// Same as setup() for a sparse solver.
+	EIGEN_GUROBI_API void setup(GurobiSparse& qp, bool applyParameters = true) const;
+
+	/// Solves the current record, of kind DENSE, with qp set up by setup().
+	EIGEN_GUROBI_API bool solve(GurobiDense& qp) const;
+	/// Solves the current record, of kind SPARSE, with qp set up by setup().
+	EIGEN_GUROBI_API bool solve(GurobiSparse& qp) const;
+
+private:
+	void read(void* dst, std::size_t size);
+	/// Pointer to the data at pos, where size bytes are readable.
+	const char* at(std::size_t pos, std::size_t size) const;
+	void readDense(GurobiRecorder::Block& block);
+	/// @return true if the block changed.
+	bool readSparse(GurobiRecorder::Block& block);
+
+private:
+	std::vector<char> data_;
+	std::size_t pos_;
+
+	GurobiRecorder::Kind kind_;
+	int nrvar_, nreq_, nrineq_;
+	GurobiRecorder::Parameters parameters_;
+	std::array<GurobiRecorder::Block, GurobiRecorder::NR_BLOCKS> dense_, sparse_;
+	SparseMatrix<double> Q_, Aeq_, Aineq_;
+	SparseVector<double> C_, Beq_, Bineq_;
+};
+
+} // namespace Eigen
@@ -15,7 +15,12 @@
 
 // includes
 // std
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <string>
 #include <type_traits>
 
 // Catch2
@@ -26,6 +31,32 @@
 
 // eigen-quadprog
 #include <Gurobi.h>
+#include <GurobiFixed.h>
+#include <GurobiPool.h>
+#include <GurobiRecorder.h>
+
+
+// Counts the allocations made through operator new, to check that the
+// steady-state solve path does not allocate.
+namespace
+{
+std::atomic<std::size_t> nrAllocations(0);
+}
+
+void* operator new(std::size_t size)
+{
+	++nrAllocations;
+	if (void* ptr = std::malloc(size > 0 ? size : 1))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
 
 
 struct QP1
@@ -73,6 +104,22 @@ struct QP1
 	Eigen::VectorXd C, Beq, Bineq, XL, XU, X;
 };
 
+/// QP1 with the sparse versions of its matrices and vectors.
+struct SQP1 : public QP1
+{
+	SQP1():
+		SQ(Q.sparseView()),
+		SAeq(Aeq.sparseView()),
+		SAineq(Aineq.sparseView()),
+		SC(C.sparseView()),
+		SBeq(Beq.sparseView()),
+		SBineq(Bineq.sparseView())
+	{ }
+
+	Eigen::SparseMatrix<double> SQ, SAeq, SAineq;
+	Eigen::SparseVector<double> SC, SBeq, SBineq;
+};
+
 
 TEST_CASE("Test dense version", "[GurobiDense]")
 {
@@ -173,4 +220,1098 @@ TEST_CASE("Test dual variables", "[Dual]")
 	CHECK(dual_eq.size() == qp1.nreq);
 	Eigen::VectorXd dual_ineq = qp.dual_ineq();
 	CHECK(dual_ineq.size() == qp1.nrineq);
+
+	Eigen::VectorXd out = Eigen::VectorXd::Zero(qp1.nrvar + qp1.nreq + qp1.nrineq);
+	qp.result(out.head(qp1.nrvar));
+	qp.dual_eq(out.segment(qp1.nrvar, qp1.nreq));
+	qp.dual_ineq(out.tail(qp1.nrineq));
+	CHECK((out.head(qp1.nrvar) - qp.result()).norm() == Approx(0).margin(1e-12));
+	CHECK((out.segment(qp1.nrvar, qp1.nreq) - dual_eq).norm() == Approx(0).margin(1e-12));
+	CHECK((out.tail(qp1.nrineq) - dual_ineq).norm() == Approx(0).margin(1e-12));
+}
+
+TEST_CASE("Test incremental objective", "[GurobiDense]")
+{
+	QP1 qp1;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Only the linear part changes
+	Eigen::VectorXd C2 = qp1.C;
+	C2(0) = -1.;
+	C2(3) = 2.;
+
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	ref.incrementalObjective(false);
+	REQUIRE(ref.solve(qp1.Q, C2, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	REQUIRE(qp.solve(qp1.Q, C2, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	qp.updateLinearObjective(qp1.C);
+	REQUIRE(qp.solve(qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test sparse pattern update", "[GurobiSparse]")
+{
+	SQP1 qp1;
+
+	Eigen::GurobiSparse qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Same pattern, different values
+	Eigen::MatrixXd Aineq2 = qp1.Aineq;
+	Aineq2(0, 1) = 2.;
+	// Different pattern: one entry removed and one added
+	Aineq2(1, 0) = 0.;
+	Aineq2(1, 1) = 1.;
+	Eigen::SparseMatrix<double> SAineq2(Aineq2.sparseView());
+
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq2, qp1.Bineq, qp1.XL, qp1.XU));
+
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, SAineq2, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	// Back to the original pattern
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test sparse problem loading", "[GurobiSparse]")
+{
+	SQP1 qp1;
+
+	Eigen::SparseMatrix<double, Eigen::RowMajor> csrAeq(qp1.SAeq);
+	Eigen::SparseMatrix<double, Eigen::RowMajor> csrAineq(qp1.SAineq);
+
+	Eigen::GurobiSparse qp;
+	qp.displayOutput(false);
+	qp.loadProblem(qp1.SQ, qp1.SC, csrAeq, qp1.SBeq, csrAineq, qp1.SBineq, qp1.XL, qp1.XU);
+
+	REQUIRE(qp.optimize());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test warm start", "[WarmStart]")
+{
+	QP1 qp1;
+	using WS = Eigen::GurobiCommon::WarmStatus;
+
+	for (WS ws : {WS::DEFAULT, WS::PRIMAL, WS::DUAL, WS::NONE, WS::PRIMAL_DUAL, WS::BASIS})
+	{
+		Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+		qp.displayOutput(false);
+		qp.warmStart(ws);
+		REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+	}
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	Eigen::VectorXd Yeq = qp.dual_eq();
+	Eigen::VectorXd Yineq = qp.dual_ineq();
+
+	qp.warmStart(qp1.X, Yeq, Yineq);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test solve statistics", "[SolverParameters]")
+{
+	QP1 qp1;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	CHECK(!qp.collectStats());
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	const Eigen::GurobiCommon::SolveStats& stats = qp.stats();
+	CHECK(stats.apiCalls > 0);
+	CHECK(stats.coeffsChanged >= qp1.nrvar*(qp1.nreq + qp1.nrineq));
+	CHECK(stats.optimizeTime > 0.);
+	CHECK(stats.optimizeTime >= stats.runtime*0.5);
+	CHECK(stats.barrierIterations == qp.iter());
+}
+
+TEST_CASE("Test allocation free re-solve", "[GurobiDense]")
+{
+	QP1 qp1;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+
+	// Q is given as a block of a bigger matrix, and the result written in a segment
+	Eigen::MatrixXd bigQ = Eigen::MatrixXd::Zero(qp1.nrvar + 2, qp1.nrvar + 2);
+	bigQ.topLeftCorner(qp1.nrvar, qp1.nrvar) = qp1.Q;
+	Eigen::VectorXd out = Eigen::VectorXd::Zero(qp1.nrvar + 2);
+
+	// The first solve builds the model
+	REQUIRE(qp.solve(bigQ.topLeftCorner(qp1.nrvar, qp1.nrvar), qp1.C,
+		qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	bool ok = true;
+	std::size_t before = nrAllocations;
+	for(int i = 0; i < 10; ++i)
+	{
+		ok = qp.solve(bigQ.topLeftCorner(qp1.nrvar, qp1.nrvar), qp1.C,
+			qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU) && ok;
+		qp.result(out.segment(1, qp1.nrvar));
+	}
+	std::size_t after = nrAllocations;
+
+	REQUIRE(ok);
+	CHECK(after == before);
+	CHECK((out.segment(1, qp1.nrvar) - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test allocation free sparse re-solve", "[GurobiSparse]")
+{
+	// The equality and inequality blocks have different sizes
+	SQP1 qp1;
+	REQUIRE(qp1.nreq != qp1.nrineq);
+
+	Eigen::GurobiSparse qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	Eigen::VectorXd out = Eigen::VectorXd::Zero(qp1.nrvar);
+
+	// The first solve builds the model
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+
+	bool ok = true;
+	std::size_t before = nrAllocations;
+	for(int i = 0; i < 10; ++i)
+	{
+		ok = qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU) && ok;
+		qp.result(out);
+	}
+	std::size_t after = nrAllocations;
+
+	REQUIRE(ok);
+	CHECK(after == before);
+	CHECK((out - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// An unchanged objective is not sent again, only the constraint values are
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK(qp.stats().coeffsChanged == qp1.SAeq.nonZeros() + qp1.SAineq.nonZeros());
+}
+
+TEST_CASE("Test solver pool", "[GurobiSolverPool]")
+{
+	QP1 qp1;
+	const int nrProblems = 8;
+
+	Eigen::GurobiSolverPool pool(2, 1);
+	CHECK(pool.nrWorkers() == 2);
+	// The parameters of the pool environment reach the solvers
+	pool.env()->set(GRB_DoubleParam_FeasibilityTol, 1e-7);
+
+	std::vector<Eigen::VectorXd> results(nrProblems);
+	std::vector<const Eigen::GurobiDense*> solvers(nrProblems, nullptr);
+	std::vector<int> status = pool.solveDenseBatch(nrProblems,
+		[&](int i, Eigen::GurobiDense& qp)
+		{
+			qp.problem(qp1.nrvar, qp1.nreq, qp1.nrineq);
+			qp.displayOutput(false);
+			qp.solve(qp1.Q, (1. + 0.1*i)*qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU);
+			results[static_cast<size_t>(i)] = qp.result();
+			solvers[static_cast<size_t>(i)] = &qp;
+		});
+
+	// Job i runs on worker i % nrWorkers, each worker with its own copy of
+	// the pool environment
+	CHECK(solvers[0] != solvers[1]);
+	CHECK(solvers[0]->env() != solvers[1]->env());
+	CHECK(solvers[0]->env() != pool.env());
+	CHECK(solvers[0]->env()->get(GRB_DoubleParam_FeasibilityTol) == Approx(1e-7));
+	for(int i = 0; i < nrProblems; ++i)
+	{
+		CHECK(solvers[static_cast<size_t>(i)] == solvers[static_cast<size_t>(i % 2)]);
+	}
+
+	REQUIRE(status.size() == static_cast<size_t>(nrProblems));
+	for(int i = 0; i < nrProblems; ++i)
+	{
+		CHECK(status[static_cast<size_t>(i)] == GRB_OPTIMAL);
+
+		std::unique_ptr<Eigen::GurobiDense> ref = pool.makeDense();
+		CHECK(ref->env() != pool.env());
+		CHECK(ref->env()->get(GRB_DoubleParam_FeasibilityTol) == Approx(1e-7));
+		ref->problem(qp1.nrvar, qp1.nreq, qp1.nrineq);
+		ref->displayOutput(false);
+		REQUIRE(ref->solve(qp1.Q, (1. + 0.1*i)*qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		CHECK((results[static_cast<size_t>(i)] - ref->result()).norm() == Approx(0).margin(1e-6));
+	}
+}
+
+TEST_CASE("Test asynchronous solve", "[GurobiDense]")
+{
+	QP1 qp1;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+
+	{
+		Eigen::GurobiCommon::AsyncSolve handle = qp.solveAsync(qp1.Q, qp1.C,
+			qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU);
+		REQUIRE(handle.wait(10.));
+		CHECK(handle.done());
+		CHECK(handle.poll());
+	}
+	REQUIRE(qp.success());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Cancelling a finished optimization keeps its result
+	Eigen::GurobiCommon::AsyncSolve handle = qp.optimizeAsync();
+	handle.wait();
+	handle.cancel();
+	CHECK(qp.status() != GRB_INPROGRESS);
+}
+
+TEST_CASE("Test deadline mode", "[SolverParameters]")
+{
+	QP1 qp1;
+	using SQ = Eigen::GurobiCommon::SolutionQuality;
+	using RP = Eigen::GurobiCommon::ResultPolicy;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	qp.timeLimit(10.);
+	qp.iterationLimit(1e6);
+	CHECK(qp.timeLimit() == Approx(10.));
+	CHECK(qp.iterationLimit() == Approx(1e6));
+	CHECK(qp.resultPolicy() == RP::OPTIMAL);
+
+	// Stop the barrier before its first iteration
+	qp.resultPolicy(RP::BEST_AVAILABLE);
+	qp.barrierIterationLimit(0);
+	CHECK(qp.barrierIterationLimit() == 0);
+	CHECK(!qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK(qp.status() == GRB_ITERATION_LIMIT);
+	if (qp.solutionQuality() == SQ::NONE)
+	{
+		CHECK_THROWS(qp.result());
+	}
+	else
+	{
+		CHECK(qp.result().size() == qp1.nrvar);
+	}
+
+	qp.barrierIterationLimit(1000);
+	REQUIRE(qp.optimize());
+	CHECK(qp.solutionQuality() == SQ::OPTIMAL);
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// A MIQP with ranges stopped at its first solution has an incumbent
+	std::shared_ptr<GRBEnv> env = std::make_shared<GRBEnv>();
+	env->set(GRB_IntParam_OutputFlag, 0);
+	env->set(GRB_IntParam_SolutionLimit, 1);
+	env->set(GRB_IntParam_Presolve, 0);
+	Eigen::MatrixXd Aeq(0, qp1.nrvar);
+	Eigen::VectorXd Beq(0);
+	Eigen::VectorXd BineqL(qp1.Bineq.array() - 1e6);
+	Eigen::GurobiDense mip(env);
+	mip.problem(qp1.nrvar, 0, qp1.nrineq);
+	mip.resultPolicy(RP::BEST_AVAILABLE);
+	for(int i = 0; i < qp1.nrvar; ++i)
+	{
+		mip.setVariableType(i, GRB_INTEGER);
+	}
+	CHECK(!mip.solve(qp1.Q, qp1.C, Aeq, Beq, qp1.Aineq, BineqL, qp1.Bineq, qp1.XL, qp1.XU));
+	REQUIRE(mip.status() == GRB_SOLUTION_LIMIT);
+	REQUIRE(mip.solutionQuality() == SQ::INCUMBENT);
+	const Eigen::VectorXd& X = mip.result();
+	const Eigen::VectorXd AX = qp1.Aineq*X;
+	CHECK((X.array() - X.array().round()).matrix().norm() == Approx(0).margin(1e-6));
+	CHECK((X.array() >= qp1.XL.array() - 1e-6).all());
+	CHECK((X.array() <= qp1.XU.array() + 1e-6).all());
+	CHECK((AX.array() >= BineqL.array() - 1e-6).all());
+	CHECK((AX.array() <= qp1.Bineq.array() + 1e-6).all());
+	// The slacks are the ones of the incumbent
+	CHECK((mip.slack_ineq() - (qp1.Bineq - AX)).norm() == Approx(0).margin(1e-6));
+	CHECK_THROWS(mip.dual_ineq());
+}
+
+TEST_CASE("Test incremental resize", "[GurobiDense]")
+{
+	SQP1 qp1;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	qp.warmStart(Eigen::GurobiCommon::WarmStatus::PRIMAL_DUAL);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	// Drop the first inequality
+	Eigen::MatrixXd Aineq1 = qp1.Aineq.bottomRows(1);
+	Eigen::VectorXd Bineq1 = qp1.Bineq.tail(1);
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, 1);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq1, Bineq1, qp1.XL, qp1.XU));
+
+	qp.removeInequalities({0});
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq1, Bineq1, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+	CHECK(qp.dual_ineq().size() == 1);
+
+	// Add it back, after the other one
+	Eigen::MatrixXd Aineq2(2, qp1.nrvar);
+	Aineq2 << qp1.Aineq.row(1), qp1.Aineq.row(0);
+	Eigen::VectorXd Bineq2(2);
+	Bineq2 << qp1.Bineq(1), qp1.Bineq(0);
+	qp.addInequalities(1);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq2, Bineq2, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Sparse models keep their patterns through a round trip of a variable
+	Eigen::GurobiSparse sqp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	sqp.displayOutput(false);
+	REQUIRE(sqp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+
+	sqp.addVariables(1);
+	sqp.removeVariables({qp1.nrvar});
+	sqp.removeEqualities({2});
+	sqp.addEqualities(1);
+	REQUIRE(sqp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((sqp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test integer variables", "[MIQP]")
+{
+	QP1 qp1;
+
+	Eigen::MatrixXd Aeq(0, qp1.nrvar);
+	Eigen::VectorXd Beq(0);
+	Eigen::GurobiDense qp(qp1.nrvar, 0, qp1.nrineq);
+	qp.displayOutput(false);
+
+	Eigen::VectorXi indices(qp1.nrvar);
+	for(int i = 0; i < qp1.nrvar; ++i)
+	{
+		indices(i) = i;
+	}
+	qp.setVariableTypes(indices, GRB_INTEGER);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, Aeq, Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	const Eigen::VectorXd& X = qp.result();
+	CHECK((X.array() - X.array().round()).matrix().norm() == Approx(0).margin(1e-6));
+	CHECK(qp.mipGap() <= 1e-4);
+	CHECK(qp.objBound() <= 0.5*X.dot(X) + qp1.C.dot(X) + 1e-6);
+	CHECK_THROWS(qp.dual_ineq());
+
+	REQUIRE(qp.solutionCount() >= 1);
+	Eigen::VectorXd X0(qp1.nrvar);
+	double obj0 = qp.poolSolution(0, X0);
+	CHECK((X0 - X).norm() == Approx(0).margin(1e-6));
+	CHECK(obj0 == Approx(0.5*X.dot(X) + qp1.C.dot(X)));
+
+	// Back to a continuous problem: the duals are available again
+	qp.setVariableTypes(indices, std::vector<char>(static_cast<size_t>(qp1.nrvar), GRB_CONTINUOUS));
+	REQUIRE(qp.optimize());
+	CHECK(qp.dual_ineq().size() == qp1.nrineq);
+}
+
+TEST_CASE("Test fixed-size version", "[GurobiDenseFixed]")
+{
+	QP1 qp1;
+	typedef Eigen::GurobiDenseFixed<6, 3, 2> Fixed;
+
+	Fixed::QMatrix Q = qp1.Q;
+	Fixed::VarVector C = qp1.C, XL = qp1.XL, XU = qp1.XU;
+	Fixed::EqMatrix Aeq = qp1.Aeq;
+	Fixed::EqVector Beq = qp1.Beq;
+	Fixed::IneqMatrix Aineq = qp1.Aineq;
+	Fixed::IneqVector Bineq = qp1.Bineq;
+
+	Fixed qp;
+	qp.displayOutput(false);
+	qp.collectStats(true);
+	REQUIRE(qp.solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Only the changed coefficient is sent
+	Eigen::MatrixXd Aineq2 = qp1.Aineq;
+	Aineq2(0, 1) = 2.;
+	Aineq(0, 1) = 2.;
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq2, qp1.Bineq, qp1.XL, qp1.XU));
+
+	REQUIRE(qp.solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU));
+	CHECK(qp.stats().coeffsChanged == 1);
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	// A new Q is sent with the whole objective
+	Q *= 2.;
+	REQUIRE(ref.solve(2.*qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq2, qp1.Bineq, qp1.XL, qp1.XU));
+	REQUIRE(qp.solve(Q, C, Aeq, Beq, Aineq, Bineq, XL, XU));
+	CHECK(qp.stats().coeffsChanged == qp1.nrvar + qp1.nrvar);
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test hessian structure", "[GurobiDense]")
+{
+	QP1 qp1;
+	using HS = Eigen::GurobiDense::HessianStructure;
+
+	// Symmetric tridiagonal matrix, given unsymmetrically to the reference
+	Eigen::MatrixXd Q = 2.*qp1.Q;
+	for(int i = 0; i + 1 < qp1.nrvar; ++i)
+	{
+		Q(i, i+1) = Q(i+1, i) = 0.5;
+	}
+	Eigen::MatrixXd Qgen = 2.*Q.triangularView<Eigen::StrictlyUpper>().toDenseMatrix();
+	Qgen.diagonal() = Q.diagonal();
+
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	ref.hessianStructure(HS::GENERAL);
+	REQUIRE(ref.solve(Qgen, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	CHECK(qp.hessianStructure() == HS::AUTO);
+	for(HS structure: {HS::AUTO, HS::SYMMETRIC, HS::BANDED})
+	{
+		qp.hessianStructure(structure, 1);
+		REQUIRE(qp.solve(Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+	}
+	CHECK(qp.hessianBandwidth() == 1);
+
+	// Only the diagonal of the same Q is read once the structure changes
+	Eigen::MatrixXd Qdiag = Q.diagonal().asDiagonal();
+	REQUIRE(ref.solve(Qdiag, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	qp.hessianStructure(HS::DIAGONAL);
+	REQUIRE(qp.solve(Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	// Diagonal fast path
+	qp.hessianStructure(HS::DIAGONAL);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test least squares", "[GurobiSparse]")
+{
+	SQP1 qp1;
+
+	// 1/2 x^T x + c^T x = 1/2 ||x + c||^2 - 1/2 c^T c
+	Eigen::SparseMatrix<double> J(qp1.SQ);
+	Eigen::VectorXd r = -qp1.C;
+
+	Eigen::GurobiSparse qp;
+	qp.displayOutput(false);
+	REQUIRE(qp.solveLeastSquares(J, r, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK(qp.nrvar() == qp1.nrvar);
+	CHECK(qp.nreq() == qp1.nreq);
+	REQUIRE(qp.result().size() == qp1.nrvar);
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+	REQUIRE(qp.residuals().size() == J.rows());
+	CHECK((qp.residuals() - (qp1.X - r)).norm() == Approx(0).margin(1e-6));
+
+	// The duals of the equalities are those of the QP
+	Eigen::GurobiSparse ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	REQUIRE(qp.dual_eq().size() == qp1.nreq);
+	CHECK((qp.dual_eq() - ref.dual_eq()).norm() == Approx(0).margin(1e-5));
+
+	// Same pattern: only the changed values are sent
+	qp.collectStats(true);
+	REQUIRE(qp.solveLeastSquares(J, r, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK(qp.stats().coeffsChanged == qp1.SAeq.nonZeros() + qp1.SAineq.nonZeros() + J.nonZeros());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// The residuals are not part of a saved model
+	const std::string path = "EigenGurobiLeastSquares.mps";
+	CHECK_THROWS(qp.saveModel(path));
+
+	// A regular solve removes the residuals
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK(qp.residuals().size() == 0);
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// And the model can be saved and loaded again
+	qp.saveModel(path);
+	Eigen::GurobiSparse loaded(path);
+	loaded.displayOutput(false);
+	REQUIRE(loaded.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((loaded.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+	for(const std::string& file: {path, path + ".prm", path + ".idx"})
+	{
+		std::remove(file.c_str());
+	}
+}
+
+TEST_CASE("Test bounds and rhs dirty tracking", "[SolverParameters]")
+{
+	SQP1 qp1;
+
+	Eigen::GurobiDense dense(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	Eigen::GurobiSparse sparse(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	dense.displayOutput(false);
+	sparse.displayOutput(false);
+	dense.collectStats(true);
+	sparse.collectStats(true);
+
+	REQUIRE(dense.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	REQUIRE(sparse.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	REQUIRE(dense.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	REQUIRE(sparse.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	int denseCalls = dense.stats().apiCalls;
+	int sparseCalls = sparse.stats().apiCalls;
+
+	// Changing one bound sends a single range
+	Eigen::VectorXd XU = qp1.XU;
+	XU(0) = 1.;
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, XU));
+
+	REQUIRE(dense.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, XU));
+	CHECK(dense.stats().apiCalls == denseCalls + 1);
+	CHECK((dense.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	REQUIRE(sparse.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, XU));
+	CHECK(sparse.stats().apiCalls == sparseCalls + 1);
+	CHECK((sparse.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test sparse rhs update", "[GurobiSparse]")
+{
+	SQP1 qp1;
+
+	Eigen::GurobiSparse qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+
+	// A right hand side going back to zero is no longer in the sparse vector
+	Eigen::VectorXd Bineq = qp1.Bineq;
+	Bineq(1) = 0.;
+	Eigen::SparseVector<double> SBineq2(Bineq.sparseView());
+	REQUIRE(SBineq2.nonZeros() == 1);
+
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, Bineq, qp1.XL, qp1.XU));
+
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, SBineq2, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	// Unchanged right hand sides are not sent again
+	int nrCalls = qp.stats().apiCalls;
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, SBineq2, qp1.XL, qp1.XU));
+	CHECK(qp.stats().apiCalls == nrCalls - 1);
+}
+
+TEST_CASE("Test model save and load", "[GurobiSparse]")
+{
+	SQP1 qp1;
+
+	const std::string path = "EigenGurobiQPTest.mps";
+	int nrCalls = 0;
+	{
+		Eigen::GurobiSparse qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+		qp.displayOutput(false);
+		qp.collectStats(true);
+		REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+		REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+		nrCalls = qp.stats().apiCalls;
+		qp.saveModel(path);
+	}
+
+	Eigen::GurobiSparse qp(path);
+	REQUIRE(qp.optimize());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// The loaded patterns, bounds and right hand sides match the data:
+	// the next solve costs the same as a re-solve, plus the objective that is
+	// not read back
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK(qp.stats().apiCalls == nrCalls + 1);
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	Eigen::GurobiDense dense(path);
+	REQUIRE(dense.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((dense.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	for(const std::string& file: {path, path + ".prm", path + ".idx"})
+	{
+		std::remove(file.c_str());
+	}
+}
+
+TEST_CASE("Test parametric solve", "[GurobiDense]")
+{
+	SQP1 qp1;
+
+	Eigen::MatrixXd Cs(qp1.nrvar, 3);
+	Cs << qp1.C, 2.*qp1.C, qp1.C;
+	Eigen::MatrixXd Bineqs(qp1.nrineq, 3);
+	Bineqs << qp1.Bineq, qp1.Bineq, qp1.Bineq + Eigen::VectorXd::Ones(qp1.nrineq);
+
+	Eigen::MatrixXd Xref(qp1.nrvar, 3);
+	for(int k = 0; k < 3; ++k)
+	{
+		Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+		ref.displayOutput(false);
+		REQUIRE(ref.solve(qp1.Q, Cs.col(k), qp1.Aeq, qp1.Beq, qp1.Aineq, Bineqs.col(k), qp1.XL, qp1.XU));
+		Xref.col(k) = ref.result();
+	}
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	Eigen::MatrixXd X(qp1.nrvar, 3);
+	std::vector<int> status = qp.solveParametric(qp1.Q, Cs, qp1.Aeq, qp1.Beq,
+		qp1.Aineq, Bineqs, qp1.XL, qp1.XU, X);
+	REQUIRE(status.size() == 3);
+	for(int s: status)
+	{
+		CHECK(s == GRB_OPTIMAL);
+	}
+	CHECK((X - Xref).norm() == Approx(0).margin(1e-5));
+
+	Eigen::GurobiSparse sqp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	sqp.displayOutput(false);
+	X.setZero();
+	status = sqp.solveParametric(qp1.SQ, Cs, qp1.SAeq, qp1.Beq, qp1.SAineq, Bineqs, qp1.XL, qp1.XU, X);
+	CHECK(status[2] == GRB_OPTIMAL);
+	CHECK((X - Xref).norm() == Approx(0).margin(1e-5));
+}
+
+TEST_CASE("Test parameter profiles", "[SolverParameters]")
+{
+	QP1 qp1;
+	using Params = Eigen::GurobiCommon::SolverParameters;
+	using Method = Eigen::GurobiCommon::Method;
+	using Presolve = Eigen::GurobiCommon::Presolve;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+
+	Params defaults = qp.parameters();
+	CHECK(defaults.method == Method::AUTOMATIC);
+	CHECK(defaults.threads == 0);
+	CHECK(defaults.presolve == Presolve::AUTOMATIC);
+
+	qp.parameters(Params::realTime());
+	CHECK(qp.method() == Method::DUAL_SIMPLEX);
+	CHECK(qp.threads() == 1);
+	CHECK(qp.presolve() == Presolve::OFF);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	Params params = Params::offline();
+	params.crossover = 0;
+	params.barrierConvergenceTolerance = 1e-10;
+	params.scaleFlag = 2;
+	params.numericFocus = 1;
+	qp.parameters(params);
+	CHECK(qp.method() == Method::BARRIER);
+	CHECK(qp.crossover() == 0);
+	CHECK(qp.barrierConvergenceTolerance() == Approx(1e-10));
+	CHECK(qp.scaleFlag() == 2);
+	CHECK(qp.numericFocus() == 1);
+	REQUIRE(qp.optimize());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test hybrid version", "[GurobiHybrid]")
+{
+	SQP1 qp1;
+
+	Eigen::GurobiHybrid qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+
+	// Dense Hessian with sparse constraints
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.SAeq, qp1.Beq, qp1.SAineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Each block switching storage
+	REQUIRE(qp.solve(qp1.SQ, qp1.C, qp1.Aeq, qp1.Beq, qp1.SAineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.SAeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Unchanged dense data are not sent again
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.SAeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK(qp.stats().coeffsChanged == qp1.SAeq.nonZeros());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test range inequalities", "[GurobiDense]")
+{
+	SQP1 qp1;
+	const double inf = GRB_INFINITY;
+
+	// The last row 2 x4 >= -8 is a singleton, active at the solution
+	Eigen::MatrixXd Aineq(3, qp1.nrvar);
+	Aineq << qp1.Aineq, Eigen::RowVectorXd::Unit(qp1.nrvar, 3)*-2.;
+	Eigen::VectorXd Bineq(3);
+	Bineq << qp1.Bineq, 8.;
+	Eigen::VectorXd BineqL(3);
+	BineqL << -inf, -inf, -8.;
+	Eigen::VectorXd BineqU(3);
+	BineqU << qp1.Bineq, inf;
+	Eigen::MatrixXd Arange(Aineq);
+	Arange.row(2) *= -1.;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, 3);
+	qp.displayOutput(false);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq, Bineq, qp1.XL, qp1.XU));
+	Eigen::VectorXd X(qp.result()), Yineq(qp.dual_ineq());
+
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Arange, BineqL, BineqU, qp1.XL, qp1.XU));
+	CHECK((qp.result() - X).norm() == Approx(0).margin(1e-6));
+	CHECK(qp.dual_ineq()(0) == Approx(Yineq(0)).margin(1e-6));
+	CHECK(qp.dual_ineq()(1) == Approx(Yineq(1)).margin(1e-6));
+	CHECK(qp.dual_ineq()(2) == Approx(-Yineq(2)).margin(1e-6));
+
+	Eigen::GurobiSparse sqp(qp1.nrvar, qp1.nreq, 3);
+	sqp.displayOutput(false);
+	Eigen::SparseMatrix<double> SArange(Arange.sparseView());
+	REQUIRE(sqp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, SArange, BineqL, BineqU, qp1.XL, qp1.XU));
+	CHECK((sqp.result() - X).norm() == Approx(0).margin(1e-6));
+	CHECK(sqp.dual_ineq()(2) == Approx(-Yineq(2)).margin(1e-6));
+
+	// The singleton rows are kept while the zero pattern is unchanged
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Arange, BineqL, BineqU, qp1.XL, qp1.XU));
+	CHECK(qp.stats().coeffsChanged == 0);
+	Arange.row(2) *= 2.;
+	BineqL(2) *= 2.;
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Arange, BineqL, BineqU, qp1.XL, qp1.XU));
+	CHECK(qp.stats().coeffsChanged == 0);
+	CHECK((qp.result() - X).norm() == Approx(0).margin(1e-6));
+
+	// Back to plain inequalities
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, Aineq, Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - X).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test staged update", "[GurobiDense]")
+{
+	QP1 qp1;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+
+	// Changes dropped before being committed
+	qp.setC(-qp1.C);
+	CHECK(qp.updatePending());
+	qp.beginUpdate();
+	CHECK(!qp.updatePending());
+
+	qp.setQ(qp1.Q);
+	qp.setC(qp1.C);
+	qp.setAeq(qp1.Aeq, qp1.Beq);
+	qp.setAineq(qp1.Aineq, qp1.Bineq);
+	qp.setBounds(qp1.XL, qp1.XU);
+	qp.commit();
+	CHECK(!qp.updatePending());
+	REQUIRE(qp.optimize());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Only the staged data change, the rest is kept
+	Eigen::VectorXd Bineq(qp1.Bineq);
+	Bineq(0) += 1.;
+	qp.setAineq(qp1.Aineq, Bineq);
+	qp.collectStats(true);
+	qp.commit();
+	REQUIRE(qp.optimize());
+	CHECK(qp.stats().coeffsChanged == 0);
+
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+
+	// optimize() commits the staged changes
+	qp.setAineq(qp1.Aineq, qp1.Bineq);
+	REQUIRE(qp.optimize());
+	CHECK(!qp.updatePending());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+	qp.setAineq(qp1.Aineq, Bineq);
+	Eigen::GurobiCommon::AsyncSolve handle = qp.solveAsync(qp1.Q, qp1.C,
+		qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU);
+	REQUIRE(handle.wait());
+	CHECK(!qp.updatePending());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// A solve replaces the staged data it is given, the rest is still sent
+	qp.setC(-qp1.C);
+	qp.setAineq(qp1.Aineq, Bineq);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK(!qp.updatePending());
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+	qp.setC(2.*qp1.C);
+	qp.setAineq(qp1.Aineq, qp1.Bineq);
+	REQUIRE(qp.solve(qp1.Aeq, qp1.Beq, qp1.Aineq, Bineq, qp1.XL, qp1.XU));
+	CHECK(!qp.updatePending());
+	REQUIRE(ref.solve(qp1.Q, 2.*qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, Bineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+}
+
+TEST_CASE("Test output extraction", "[Dual]")
+{
+	QP1 qp1;
+
+	Eigen::GurobiDense ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	REQUIRE(ref.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	qp.extraction(Eigen::GurobiCommon::OUTPUT_PRIMAL);
+	CHECK(qp.extraction() == Eigen::GurobiCommon::OUTPUT_PRIMAL);
+	qp.collectStats(true);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	// The duals of such a small problem are read one value at a time
+	CHECK(qp.stats().apiCalls + qp1.nreq + qp1.nrineq == ref.stats().apiCalls);
+
+	// Queried on demand
+	CHECK((qp.dual_eq() - ref.dual_eq()).norm() == Approx(0).margin(1e-6));
+	CHECK((qp.dual_ineq() - ref.dual_ineq()).norm() == Approx(0).margin(1e-6));
+
+	Eigen::VectorXd slack = qp1.Bineq - qp1.Aineq*qp.result();
+	CHECK((qp.slack_ineq() - slack).norm() == Approx(0).margin(1e-6));
+
+	// Stationarity: Q x + c - Aeq' yeq - Aineq' yineq = rc
+	Eigen::VectorXd rc = qp1.Q*qp.result() + qp1.C
+		- qp1.Aeq.transpose()*qp.dual_eq() - qp1.Aineq.transpose()*qp.dual_ineq();
+	CHECK((qp.reduced_costs() - rc).norm() == Approx(0).margin(1e-5));
+}
+
+TEST_CASE("Test progress callback", "[SolverParameters]")
+{
+	QP1 qp1;
+	using Progress = Eigen::GurobiCommon::Progress;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	qp.method(Eigen::GurobiCommon::Method::BARRIER);
+	qp.presolve(Eigen::GurobiCommon::Presolve::OFF);
+
+	int calls = 0;
+	qp.progressCallback([&calls](const Progress& progress, const Eigen::VectorXd&)
+	{
+		CHECK(progress.where == GRB_CB_BARRIER);
+		++calls;
+		return true;
+	});
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK(calls > 0);
+	CHECK((qp.result() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// Stopped at the first report
+	Eigen::GurobiDense stopped(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	stopped.displayOutput(false);
+	stopped.method(Eigen::GurobiCommon::Method::BARRIER);
+	stopped.presolve(Eigen::GurobiCommon::Presolve::OFF);
+	stopped.progressCallback([](const Progress&, const Eigen::VectorXd&) { return false; });
+	CHECK(!stopped.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	CHECK(stopped.status() == GRB_INTERRUPTED);
+
+	// Detached
+	calls = 0;
+	qp.progressCallback(Eigen::GurobiCommon::ProgressCallback());
+	qp.warmStart(Eigen::GurobiCommon::WarmStatus::NONE);
+	REQUIRE(qp.optimize());
+	CHECK(calls == 0);
+}
+
+TEST_CASE("Test memory usage", "[GurobiDense]")
+{
+	SQP1 qp1;
+
+	Eigen::GurobiSparse ref(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	ref.displayOutput(false);
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+
+	Eigen::GurobiCommon::MemoryUsage usage = qp.memoryUsage();
+	CHECK(usage.wrapper > 0);
+	CHECK(usage.gurobi >= 0.);
+	CHECK(usage.gurobiPeak >= usage.gurobi);
+
+	qp.compact();
+	Eigen::GurobiCommon::MemoryUsage compacted = qp.memoryUsage();
+	CHECK(compacted.scratch <= usage.scratch);
+	CHECK(compacted.wrapper <= usage.wrapper);
+
+	// The released buffers are allocated again when needed
+	Eigen::VectorXd X = qp.result();
+	qp1.C(0) += 1.;
+	qp1.SC = qp1.C.sparseView();
+	REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+	REQUIRE(ref.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+	CHECK((qp.result() - ref.result()).norm() == Approx(0).margin(1e-6));
+	CHECK((qp.result() - X).norm() > 0.);
+
+	ref.compact();
+	CHECK(ref.memoryUsage().wrapper > 0);
+}
+
+TEST_CASE("Test solve log replay", "[GurobiRecorder]")
+{
+	SQP1 qp1;
+	const std::string path = "EigenGurobiQPTest.qplog";
+
+	std::vector<Eigen::VectorXd> results;
+	{
+		auto recorder = std::make_shared<Eigen::GurobiRecorder>(path);
+		Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+		qp.displayOutput(false);
+		qp.recorder(recorder);
+		Eigen::GurobiSparse sqp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+		sqp.displayOutput(false);
+		sqp.recorder(recorder);
+
+		REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		results.push_back(qp.result());
+		std::size_t first = recorder->bytesWritten();
+
+		// Only the changed coefficient and parameter are recorded
+		qp1.C(0) += 1.;
+		qp.feasibilityTolerance(1e-7);
+		REQUIRE(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		results.push_back(qp.result());
+		CHECK(recorder->bytesWritten() - first < first/2);
+
+		sqp.feasibilityTolerance(1e-7);
+		REQUIRE(sqp.solve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+		results.push_back(sqp.result());
+		CHECK(recorder->nrRecords() == 3);
+
+		// Each parametric instance and asynchronous solve is recorded
+		Eigen::MatrixXd Cs(qp1.nrvar, 2);
+		Cs << qp1.C, 2.*qp1.C;
+		Eigen::MatrixXd X(qp1.nrvar, 2);
+		qp.solveParametric(qp1.Q, Cs, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU, X);
+		results.push_back(X.col(0));
+		results.push_back(X.col(1));
+		Eigen::GurobiCommon::AsyncSolve handle = sqp.solveAsync(qp1.SQ, qp1.SC,
+			qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU);
+		REQUIRE(handle.wait());
+		results.push_back(sqp.result());
+		CHECK(recorder->nrRecords() == 6);
+
+		// The entry points that cannot be replayed throw
+		Eigen::VectorXd BineqL = Eigen::VectorXd::Constant(qp1.nrineq, -GRB_INFINITY);
+		CHECK_THROWS(qp.solve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, BineqL, qp1.Bineq, qp1.XL, qp1.XU));
+		CHECK_THROWS(qp.solve(qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU));
+		CHECK_THROWS(qp.updateLinearObjective(qp1.C));
+		qp.setC(qp1.C);
+		CHECK_THROWS(qp.optimize());
+		qp.beginUpdate();
+		CHECK_THROWS(sqp.solveLeastSquares(qp1.SQ, -qp1.C, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU));
+		CHECK(recorder->nrRecords() == 6);
+	}
+
+	Eigen::GurobiReplay replay(path);
+	Eigen::GurobiDense qp;
+	qp.displayOutput(false);
+	Eigen::GurobiSparse sqp;
+	sqp.displayOutput(false);
+	for(int pass = 0; pass < 2; ++pass)
+	{
+		for(const Eigen::VectorXd& X : results)
+		{
+			REQUIRE(replay.next());
+			CHECK(replay.nrvar() == qp1.nrvar);
+			CHECK(replay.nreq() == qp1.nreq);
+			CHECK(replay.nrineq() == qp1.nrineq);
+			if (replay.kind() == Eigen::GurobiRecorder::DENSE)
+			{
+				replay.setup(qp);
+				REQUIRE(replay.solve(qp));
+				CHECK((qp.result() - X).norm() == Approx(0).margin(1e-6));
+			}
+			else
+			{
+				replay.setup(sqp);
+				REQUIRE(replay.solve(sqp));
+				CHECK((sqp.result() - X).norm() == Approx(0).margin(1e-6));
+			}
+		}
+		CHECK(replay.parameters().solver.feasibilityTolerance == 1e-7);
+		CHECK(!replay.next());
+		replay.rewind();
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST_CASE("Test exception-free solve", "[GurobiDense]")
+{
+	SQP1 qp1;
+	using Quality = Eigen::GurobiCommon::SolutionQuality;
+
+	Eigen::GurobiDense qp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	qp.displayOutput(false);
+	Eigen::GurobiCommon::SolveResult res = qp.trySolve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq,
+		qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU);
+	REQUIRE(res.hasResult());
+	CHECK(res.error == 0);
+	CHECK(res.status == GRB_OPTIMAL);
+	CHECK(res.quality == Quality::OPTIMAL);
+	CHECK((res.X() - qp1.X).norm() == Approx(0).margin(1e-6));
+	REQUIRE(res.hasDual);
+	CHECK((res.dualEq() - qp.dual_eq()).norm() == 0.);
+	CHECK((res.dualIneq() - qp.dual_ineq()).norm() == 0.);
+
+	// Crossed bounds: no result, and nothing thrown
+	Eigen::VectorXd XL(qp1.XL);
+	XL(0) = qp1.XU(0) + 1.;
+	res = qp.trySolve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, XL, qp1.XU);
+	CHECK(!res.hasResult());
+	CHECK(!res.hasDual);
+	CHECK(res.error == 0);
+	CHECK((res.status == GRB_INFEASIBLE || res.status == GRB_INF_OR_UNBD));
+	CHECK(res.X().size() == 0);
+	CHECK(res.dualEq().size() == 0);
+	CHECK(qp.solveResult().status == res.status);
+
+	Eigen::GurobiSparse sqp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	sqp.displayOutput(false);
+	res = sqp.trySolve(qp1.SQ, qp1.SC, qp1.SAeq, qp1.SBeq, qp1.SAineq, qp1.SBineq, qp1.XL, qp1.XU);
+	REQUIRE(res.hasResult());
+	CHECK((res.X() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	Eigen::GurobiHybrid hqp(qp1.nrvar, qp1.nreq, qp1.nrineq);
+	hqp.displayOutput(false);
+	res = hqp.trySolve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.SAineq, qp1.Bineq, qp1.XL, qp1.XU);
+	REQUIRE(res.hasResult());
+	CHECK((res.X() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	Eigen::GurobiDenseFixed<6, 3, 2> fqp;
+	fqp.displayOutput(false);
+	res = fqp.trySolve(qp1.Q, qp1.C, qp1.Aeq, qp1.Beq, qp1.Aineq, qp1.Bineq, qp1.XL, qp1.XU);
+	REQUIRE(res.hasResult());
+	CHECK((res.X() - qp1.X).norm() == Approx(0).margin(1e-6));
+
+	// The model is unchanged: same result
+	res = fqp.tryOptimize();
+	CHECK(res.error == 0);
+	CHECK((res.X() - qp1.X).norm() == Approx(0).margin(1e-6));
 }